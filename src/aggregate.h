@@ -0,0 +1,526 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Receivers which keep rolling statistics over one numeric parameter of a
+ * signal. Attach one with
+ *
+ *   signal::window_mean<float> axis("value", 64);
+ *   m.add("joystick.x", axis.receiver());
+ *
+ * and read the result from any thread with axis.mean(). Attached as the
+ * transform of a route instead, the result is sent on a derived signal:
+ *
+ *   m.connect("joystick.x", "joystick.x.mean", axis.transform());
+ *
+ * A parameter added with add_array is taken as a batch of values, the
+ * loops over a batch are written so they vectorize. Every update is O(1)
+ * amortized. An aggregator has to outlive the signals it is attached to */
+
+#ifndef LIB_SIGNAL_AGGREGATE_H
+#define LIB_SIGNAL_AGGREGATE_H
+
+#include "libsignal.h"
+
+namespace signal
+{
+/**
+ * \brief Base of the aggregators, feeds the values of one parameter to
+ * Derived::push(values, count) and writes the results with
+ * Derived::write(out) when used as a transform
+ * \class aggregator
+ * \defgroup signal++
+ */
+template <class Derived, class T> class aggregator
+{
+    std::string m_key;
+
+  protected:
+    mutable std::mutex m_lock;
+
+    /* Set by aggregators which count sends if the key is empty */
+    static constexpr bool counts_sends = false;
+
+    explicit aggregator(std::string key) : m_key(std::move(key)) {}
+
+  public:
+    typedef T value_type;
+
+    aggregator(const aggregator &) = delete;
+    aggregator &operator=(const aggregator &) = delete;
+
+    /**
+     * \return the id of the parameter which is aggregated
+     * \defgroup signal++
+     */
+    const std::string &key() const { return m_key; }
+
+    /**
+     * \brief Add the value of the parameter, or all values if it is an
+     * array. Sends without the parameter are ignored
+     * \defgroup signal++
+     */
+    void receive(const parameters &param, parameters *)
+    {
+        auto *self = static_cast<Derived *>(this);
+        if (Derived::counts_sends && m_key.empty()) {
+            std::lock_guard<std::mutex> lock(m_lock);
+            self->push(nullptr, 1);
+            return;
+        }
+
+        bool ok = false;
+        auto values = param.template get_array<T>(m_key, &ok);
+        if (ok) {
+            std::lock_guard<std::mutex> lock(m_lock);
+            self->push(values.data, values.size);
+            return;
+        }
+        const T &value = param.template get<T>(m_key, &ok);
+        if (!ok) return;
+        std::lock_guard<std::mutex> lock(m_lock);
+        self->push(&value, 1);
+    }
+
+    /**
+     * \brief Add the values like receive() and write the results to out
+     * \defgroup signal++
+     */
+    void forward(const parameters &param, parameters *out)
+    {
+        receive(param, nullptr);
+        if (!out) return;
+        std::lock_guard<std::mutex> lock(m_lock);
+        static_cast<const Derived *>(this)->write(*out);
+    }
+
+    /**
+     * \return a receiver which updates this aggregator
+     * \defgroup signal++
+     */
+    delegate receiver() { return delegate(this, &aggregator::receive); }
+
+    /**
+     * \return a route transform for manager::connect() which updates this
+     * aggregator and sends its results
+     * \defgroup signal++
+     */
+    delegate transform() { return delegate(this, &aggregator::forward); }
+};
+
+/**
+ * \brief The last size values in a ring buffer with their running sum. The
+ * sum is recomputed every time the ring wraps, so rounding errors of a
+ * floating point sum don't add up
+ * \class value_window
+ * \defgroup signal++
+ */
+template <class T> class value_window
+{
+    std::vector<T> m_ring;
+    size_t m_next = 0, m_count = 0;
+    double m_sum = 0;
+
+    /* Four partial sums, so the loop vectorizes without reordering the
+     * additions of a floating point sum */
+    static double sum_of(const T *values, size_t count)
+    {
+        double part[4] = {};
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            for (size_t j = 0; j < 4; j++)
+                part[j] += double(values[i + j]);
+        }
+        for (; i < count; i++)
+            part[0] += double(values[i]);
+        return (part[0] + part[1]) + (part[2] + part[3]);
+    }
+
+  public:
+    explicit value_window(size_t size) : m_ring(std::max<size_t>(size, 1))
+    {
+    }
+
+    void push(const T *values, size_t count)
+    {
+        const size_t size = m_ring.size();
+        if (count >= size) {
+            std::copy(values + count - size, values + count, m_ring.begin());
+            m_next = 0;
+            m_count = size;
+            m_sum = sum_of(m_ring.data(), size);
+            return;
+        }
+
+        while (count) {
+            size_t chunk = std::min(count, size - m_next);
+            T *slot = m_ring.data() + m_next;
+            if (m_count == size) m_sum -= sum_of(slot, chunk);
+            std::copy(values, values + chunk, slot);
+            m_sum += sum_of(values, chunk);
+            m_count = std::min(m_count + chunk, size);
+            values += chunk;
+            count -= chunk;
+
+            m_next += chunk;
+            if (m_next == size) {
+                m_next = 0;
+                m_sum = sum_of(m_ring.data(), m_count);
+            }
+        }
+    }
+
+    double sum() const { return m_sum; }
+    size_t count() const { return m_count; }
+    size_t size() const { return m_ring.size(); }
+};
+
+/**
+ * \brief Sum of the last size values, written as "sum" by transform()
+ * \class window_sum
+ * \defgroup signal++
+ */
+template <class T = double>
+class window_sum : public aggregator<window_sum<T>, T>
+{
+    friend class aggregator<window_sum<T>, T>;
+    value_window<T> m_window;
+
+    void push(const T *values, size_t count) { m_window.push(values, count); }
+    void write(parameters &out) const
+    {
+        out.add<double>("sum", m_window.sum());
+    }
+
+  public:
+    window_sum(std::string key, size_t size)
+        : aggregator<window_sum<T>, T>(std::move(key)), m_window(size)
+    {
+    }
+
+    double sum() const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return m_window.sum();
+    }
+
+    /**
+     * \return the number of values in the window, at most its size
+     * \defgroup signal++
+     */
+    size_t count() const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return m_window.count();
+    }
+};
+
+/**
+ * \brief Mean of the last size values, written as "mean" by transform()
+ * \class window_mean
+ * \defgroup signal++
+ */
+template <class T = double>
+class window_mean : public aggregator<window_mean<T>, T>
+{
+    friend class aggregator<window_mean<T>, T>;
+    value_window<T> m_window;
+
+    void push(const T *values, size_t count) { m_window.push(values, count); }
+    void write(parameters &out) const { out.add<double>("mean", get()); }
+
+    double get() const
+    {
+        return m_window.count() ? m_window.sum() / double(m_window.count())
+                                : 0;
+    }
+
+  public:
+    window_mean(std::string key, size_t size)
+        : aggregator<window_mean<T>, T>(std::move(key)), m_window(size)
+    {
+    }
+
+    /**
+     * \return the mean, zero before the first value
+     * \defgroup signal++
+     */
+    double mean() const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return get();
+    }
+};
+
+/**
+ * \brief Minimum and maximum of the last size values, written as "min" and
+ * "max" by transform(). Each bound is kept in a monotonic queue, so a new
+ * value only drops the values it replaces
+ * \class window_minmax
+ * \defgroup signal++
+ */
+template <class T = double>
+class window_minmax : public aggregator<window_minmax<T>, T>
+{
+    friend class aggregator<window_minmax<T>, T>;
+
+    /* Candidates for the bound in the order they were added, Before(a, b)
+     * is true if a replaces b */
+    template <class Before> struct mono_queue {
+        std::vector<std::pair<uint64_t, T>> ring;
+        size_t head = 0, count = 0;
+
+        explicit mono_queue(size_t size) : ring(size) {}
+
+        auto &at(size_t i) { return ring[(head + i) % ring.size()]; }
+        const T &front() const { return ring[head].second; }
+
+        void push(uint64_t seq, const T &value, uint64_t oldest)
+        {
+            while (count && !Before()(at(count - 1).second, value))
+                count--;
+            while (count && at(0).first < oldest) {
+                head = (head + 1) % ring.size();
+                count--;
+            }
+            at(count++) = {seq, value};
+        }
+    };
+
+    struct keeps_min {
+        bool operator()(const T &kept, const T &added) const
+        {
+            return kept < added;
+        }
+    };
+    struct keeps_max {
+        bool operator()(const T &kept, const T &added) const
+        {
+            return added < kept;
+        }
+    };
+
+    size_t m_size;
+    uint64_t m_seq = 0;
+    mono_queue<keeps_min> m_min;
+    mono_queue<keeps_max> m_max;
+
+    void push(const T *values, size_t count)
+    {
+        if (count > m_size) {
+            m_seq += count - m_size;
+            values += count - m_size;
+            count = m_size;
+        }
+        for (size_t i = 0; i < count; i++, m_seq++) {
+            const uint64_t oldest =
+                m_seq + 1 > m_size ? m_seq + 1 - m_size : 0;
+            m_min.push(m_seq, values[i], oldest);
+            m_max.push(m_seq, values[i], oldest);
+        }
+    }
+
+    void write(parameters &out) const
+    {
+        if (!m_min.count) return;
+        out.add<T>("min", m_min.front());
+        out.add<T>("max", m_max.front());
+    }
+
+  public:
+    window_minmax(std::string key, size_t size)
+        : aggregator<window_minmax<T>, T>(std::move(key)),
+          m_size(std::max<size_t>(size, 1)), m_min(m_size), m_max(m_size)
+    {
+    }
+
+    /**
+     * \param ok will be set to false before the first value (optional)
+     * \return the smallest value in the window
+     * \defgroup signal++
+     */
+    T min(bool *ok = nullptr) const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (ok) *ok = m_min.count > 0;
+        return m_min.count ? m_min.front() : T();
+    }
+
+    /**
+     * \param ok will be set to false before the first value (optional)
+     * \return the largest value in the window
+     * \defgroup signal++
+     */
+    T max(bool *ok = nullptr) const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        if (ok) *ok = m_max.count > 0;
+        return m_max.count ? m_max.front() : T();
+    }
+};
+
+/**
+ * \brief Exponentially weighted moving average, written as "ewma" by
+ * transform(). Each value moves the average by alpha times its distance
+ * \class ewma
+ * \defgroup signal++
+ */
+template <class T = double> class ewma : public aggregator<ewma<T>, T>
+{
+    friend class aggregator<ewma<T>, T>;
+    double m_alpha, m_value = 0;
+    bool m_set = false;
+
+    void push(const T *values, size_t count)
+    {
+        size_t i = 0;
+        if (!m_set && count) {
+            m_value = double(values[i++]);
+            m_set = true;
+        }
+        for (; i < count; i++)
+            m_value += m_alpha * (double(values[i]) - m_value);
+    }
+
+    void write(parameters &out) const { out.add<double>("ewma", m_value); }
+
+  public:
+    /**
+     * \param key the id of the parameter
+     * \param alpha the weight of a new value, between 0 and 1
+     * \defgroup signal++
+     */
+    ewma(std::string key, double alpha)
+        : aggregator<ewma<T>, T>(std::move(key)), m_alpha(alpha)
+    {
+    }
+
+    /**
+     * \return the average, zero before the first value
+     * \defgroup signal++
+     */
+    double value() const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return m_value;
+    }
+};
+
+/**
+ * \brief Values per second over a time window, written as "rate" by
+ * transform(). The window is split into buckets which are reused as time
+ * passes, so the rate is exact to one bucket. With an empty key every send
+ * counts as one value, e.g. for clicks per second
+ * \class rate
+ * \defgroup signal++
+ */
+template <class T = double> class rate : public aggregator<rate<T>, T>
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+
+  private:
+    friend class aggregator<rate<T>, T>;
+    static constexpr bool counts_sends = true;
+
+    mutable std::vector<uint64_t> m_buckets;
+    mutable int64_t m_current = -1; /* bucket of the newest value */
+    mutable uint64_t m_total = 0;
+    clock::duration m_width;
+
+    /* Clears the buckets which fell out of the window until now */
+    void advance(clock::time_point now) const
+    {
+        const int64_t index = int64_t(now.time_since_epoch() / m_width);
+        const int64_t size = int64_t(m_buckets.size());
+        if (m_current < 0 || index - m_current >= size) {
+            std::fill(m_buckets.begin(), m_buckets.end(), 0);
+            m_total = 0;
+        } else {
+            for (int64_t i = m_current + 1; i <= index; i++) {
+                auto &bucket = m_buckets[size_t(i % size)];
+                m_total -= bucket;
+                bucket = 0;
+            }
+        }
+        m_current = std::max(m_current, index);
+    }
+
+    double get(clock::time_point now) const
+    {
+        advance(now);
+        std::chrono::duration<double> window = m_width * m_buckets.size();
+        return double(m_total) / window.count();
+    }
+
+    void count(uint64_t values, clock::time_point now)
+    {
+        advance(now);
+        m_buckets[size_t(m_current) % m_buckets.size()] += values;
+        m_total += values;
+    }
+
+    void push(const T *, size_t values) { count(values, clock::now()); }
+
+    void write(parameters &out) const
+    {
+        out.add<double>("rate", get(clock::now()));
+    }
+
+  public:
+    /**
+     * \param key the id of the parameter, empty to count sends
+     * \param window the time the rate is measured over
+     * \param buckets the resolution of the window
+     * \defgroup signal++
+     */
+    explicit rate(std::string key = std::string(),
+                  clock::duration window = std::chrono::seconds(1),
+                  size_t buckets = 10)
+        : aggregator<rate<T>, T>(std::move(key)),
+          m_buckets(std::max<size_t>(buckets, 1)),
+          m_width(std::max(window / clock::rep(m_buckets.size()),
+                           clock::duration(1)))
+    {
+    }
+
+    /**
+     * \brief Count values which arrived at the given time, e.g. to feed
+     * recorded events
+     * \defgroup signal++
+     */
+    void add(uint64_t values, clock::time_point now = clock::now())
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        count(values, now);
+    }
+
+    /**
+     * \param now the current time
+     * \return the values per second over the window before now
+     * \defgroup signal++
+     */
+    double per_second(clock::time_point now = clock::now()) const
+    {
+        std::lock_guard<std::mutex> lock(this->m_lock);
+        return get(now);
+    }
+};
+}; // namespace signal
+
+#endif /* Header guard */
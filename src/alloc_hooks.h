@@ -0,0 +1,128 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Replaces the global operator new and delete to update
+ * signal::alloc_stats::thread(). Include this in exactly one source file of
+ * the application */
+
+#ifndef LIB_SIGNAL_ALLOC_HOOKS_H
+#define LIB_SIGNAL_ALLOC_HOOKS_H
+
+#include "libsignal.h"
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+namespace signal
+{
+inline void *counted_alloc(size_t size, size_t align = 0)
+{
+    auto &stats = alloc_stats::thread();
+    ++stats.allocations;
+    stats.bytes += size;
+
+    if (size == 0) size = 1;
+    align = std::max(align, alignof(std::max_align_t));
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    void *p = nullptr;
+    if (posix_memalign(&p, align, size) != 0) return nullptr;
+    return p;
+#endif
+}
+
+inline void counted_free(void *p)
+{
+    if (!p) return;
+    ++alloc_stats::thread().deallocations;
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+}; // namespace signal
+
+void *operator new(size_t size)
+{
+    void *p = signal::counted_alloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    void *p = signal::counted_alloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    void *p = signal::counted_alloc(size, size_t(align));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size, std::align_val_t align)
+{
+    void *p = signal::counted_alloc(size, size_t(align));
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return signal::counted_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return signal::counted_alloc(size);
+}
+
+void operator delete(void *p) noexcept { signal::counted_free(p); }
+void operator delete[](void *p) noexcept { signal::counted_free(p); }
+void operator delete(void *p, size_t) noexcept { signal::counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { signal::counted_free(p); }
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    signal::counted_free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+    signal::counted_free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    signal::counted_free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+    signal::counted_free(p);
+}
+
+#endif /* Header guard */
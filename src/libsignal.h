@@ -22,37 +22,770 @@
 
 #ifdef __cplusplus /* C++ Implementation */
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
-#include <malloc.h>
+#include <deque>
+#include <limits>
+#include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#ifdef LIBSIGNAL_TRACE
+#include "trace.h"
+#endif
+
+#ifdef LINUX
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
 namespace signal
 {
 
+/**
+ * \brief Per thread allocation counters. These are only updated if the
+ * application includes alloc_hooks.h in one of its source files. If
+ * LIBSIGNAL_ALLOC_STATS is defined the manager also counts the allocations
+ * done by send and add on the calling thread
+ * \struct alloc_stats
+ * \defgroup signal++
+ */
+struct alloc_stats {
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes = 0;
+    size_t send_allocations = 0;
+    size_t add_allocations = 0;
+
+    /**
+     * \return the counters of the calling thread
+     * \defgroup signal++
+     */
+    static alloc_stats &thread()
+    {
+        static thread_local alloc_stats stats;
+        return stats;
+    }
+};
+
+/**
+ * \brief Adds the allocations done on this thread during its lifetime to
+ * a counter
+ * \class alloc_scope
+ * \defgroup signal++
+ */
+class alloc_scope
+{
+    size_t &m_counter;
+    size_t m_start;
+
+  public:
+    explicit alloc_scope(size_t &counter)
+        : m_counter(counter), m_start(alloc_stats::thread().allocations)
+    {
+    }
+
+    ~alloc_scope()
+    {
+        m_counter += alloc_stats::thread().allocations - m_start;
+    }
+};
+
+/**
+ * \brief Read only view of a contiguous array
+ * \struct array_view
+ * \defgroup signal++
+ */
+template <class T> struct array_view {
+    const T *data = nullptr;
+    size_t size = 0;
+
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+    const T &operator[](size_t i) const { return data[i]; }
+    bool empty() const { return size == 0; }
+};
+
 /**
  * \brief The parameters class, contains a list of parameters used for calling
- * signals \class parameters
+ * signals. Keys and values share one buffer which is kept on reset(), so a
+ * reused parameter list does not allocate. The buffer can also be provided by
+ * the caller, in which case the list only allocates once it runs out of space
+ * \class parameters
  */
 class parameters
 {
-    std::map<std::string, std::pair<size_t, void *>> m_parameters;
+    /* Only set for values which can't be copied with memcpy */
+    struct value_ops {
+        void (*copy)(void *dst, const void *src);
+        void (*move)(void *dst, void *src); /* also destroys src */
+        void (*destroy)(void *p);
+        size_t (*heap)(const void *p);
+        uint64_t (*hash)(const void *p);
+        bool (*equal)(const void *a, const void *b);
+    };
+
+    template <class T> static size_t heap_size(const T &) { return 0; }
+
+    template <class C>
+    static size_t heap_size(const std::basic_string<C> &str)
+    {
+        auto *p = reinterpret_cast<const char *>(str.data());
+        auto *obj = reinterpret_cast<const char *>(&str);
+        if (p >= obj && p < obj + sizeof(str)) return 0;
+        return (str.capacity() + 1) * sizeof(C);
+    }
+
+    static uint64_t mix(uint64_t h)
+    {
+        h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+        h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+        return h ^ (h >> 31);
+    }
+
+    /* Hashes eight bytes per step */
+    static uint64_t hash_bytes(const void *data, size_t size)
+    {
+        auto *p = static_cast<const unsigned char *>(data);
+        uint64_t h = 0x9e3779b97f4a7c15ull ^ size;
+        for (; size >= 8; size -= 8, p += 8) {
+            uint64_t word;
+            memcpy(&word, p, 8);
+            h = mix(h ^ word);
+        }
+        if (size) {
+            uint64_t word = 0;
+            memcpy(&word, p, size);
+            h = mix(h ^ word);
+        }
+        return h;
+    }
+
+    template <class T, class = void> struct has_std_hash : std::false_type {
+    };
+    template <class T>
+    struct has_std_hash<T, std::void_t<decltype(std::hash<T>()(
+                               std::declval<const T &>()))>>
+        : std::true_type {
+    };
+
+    template <class T, class = void> struct has_equal : std::false_type {
+    };
+    template <class T>
+    struct has_equal<T, std::void_t<decltype(std::declval<const T &>() ==
+                                             std::declval<const T &>())>>
+        : std::true_type {
+    };
+
+    /* Values which can't be hashed get a new hash every time, so they never
+     * look unchanged */
+    template <class T> static uint64_t hash_value(const T &value)
+    {
+        if constexpr (has_std_hash<T>::value) {
+            return mix(std::hash<T>()(value));
+        } else {
+            static std::atomic<uint64_t> unique{0};
+            return mix(unique.fetch_add(1, std::memory_order_relaxed));
+        }
+    }
+
+    template <class C>
+    static uint64_t hash_value(const std::basic_string<C> &str)
+    {
+        return hash_bytes(str.data(), str.size() * sizeof(C));
+    }
+
+    template <class T> static bool equal_value(const T &a, const T &b)
+    {
+        if constexpr (has_equal<T>::value)
+            return bool(a == b);
+        else
+            return &a == &b;
+    }
+
+    template <class T> struct ops_for {
+        static void copy(void *dst, const void *src)
+        {
+            new (dst) T(*static_cast<const T *>(src));
+        }
+        static void move(void *dst, void *src)
+        {
+            new (dst) T(std::move(*static_cast<T *>(src)));
+            static_cast<T *>(src)->~T();
+        }
+        static void destroy(void *p) { static_cast<T *>(p)->~T(); }
+        static size_t heap(const void *p)
+        {
+            return heap_size(*static_cast<const T *>(p));
+        }
+        static uint64_t hash(const void *p)
+        {
+            return hash_value(*static_cast<const T *>(p));
+        }
+        static bool equal(const void *a, const void *b)
+        {
+            return equal_value(*static_cast<const T *>(a),
+                               *static_cast<const T *>(b));
+        }
+
+        static const value_ops *get()
+        {
+            static const value_ops ops = {&copy,    &move, &destroy,
+                                          &heap,    &hash, &equal};
+            return std::is_trivially_copyable<T>::value ? nullptr : &ops;
+        }
+    };
+
+    /* Entries are stored at the end of the buffer and grow downwards, keys
+     * and values are stored at the start and grow upwards */
+    struct entry {
+        uint32_t hash;
+        uint32_t key;
+        uint32_t value;
+        uint32_t size;
+        uint16_t key_len;
+        uint16_t align;
+        uint16_t elem; /* element size of arrays, zero for other values */
+        uint16_t flags;
+        const value_ops *ops;
+    };
+
+    /* The float flags mark float and double values and arrays, they are
+     * compared by value so 0.0 equals -0.0 and NaN equals NaN */
+    enum entry_flags : uint16_t {
+        lazy = 1,
+        float_value = 2,
+        double_value = 4
+    };
+
+    template <class T> static constexpr uint16_t type_flags()
+    {
+        if (std::is_same<T, float>::value) return float_value;
+        if (std::is_same<T, double>::value) return double_value;
+        return 0;
+    }
+
+    /* Header of values added with add_lazy, eval creates the value on the
+     * first call and returns it. ops belongs to the created value */
+    struct lazy_base {
+        void *(*eval)(lazy_base *);
+        size_t size;
+        const value_ops *ops;
+        bool ready = false;
+    };
+
+    template <class T, class G> struct lazy_value : lazy_base {
+        G generator;
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T *get() { return reinterpret_cast<T *>(storage); }
+        const T *get() const { return reinterpret_cast<const T *>(storage); }
+
+        static void *eval(lazy_base *base)
+        {
+            auto *l = static_cast<lazy_value *>(base);
+            if (!l->ready) {
+                new (l->storage) T(l->generator());
+                l->ready = true;
+            }
+            return l->storage;
+        }
+
+        explicit lazy_value(G &&g)
+            : lazy_base{&eval, sizeof(T), ops_for<T>::get()},
+              generator(std::move(g))
+        {
+        }
+
+        lazy_value(const lazy_value &o) : lazy_base(o), generator(o.generator)
+        {
+            if (o.ready) new (storage) T(*o.get());
+            ready = o.ready;
+        }
+
+        lazy_value(lazy_value &&o)
+            : lazy_base(o), generator(std::move(o.generator))
+        {
+            if (o.ready) new (storage) T(std::move(*o.get()));
+            ready = o.ready;
+        }
+
+        ~lazy_value()
+        {
+            if (ready) get()->~T();
+        }
+    };
+
+    /* Returns the value of an entry, lazy values are evaluated first */
+    void *value_of(const entry *e, size_t &size) const
+    {
+        void *p = m_data + e->value;
+        if (e->flags & lazy) {
+            auto *l = static_cast<lazy_base *>(p);
+            size = l->size;
+            return l->eval(l);
+        }
+        size = e->size;
+        return p;
+    }
+
+    /* Bits of a float value with all zeros and NaNs made equal */
+    template <class F, class U> static U float_bits(const void *p)
+    {
+        F v;
+        memcpy(&v, p, sizeof(F));
+        if (v == 0) return 0;
+        if (v != v) v = std::numeric_limits<F>::quiet_NaN();
+        U bits;
+        memcpy(&bits, &v, sizeof(F));
+        return bits;
+    }
+
+    const value_ops *ops_of(const entry *e) const
+    {
+        if (!(e->flags & lazy)) return e->ops;
+        return reinterpret_cast<const lazy_base *>(m_data + e->value)->ops;
+    }
+
+    uint64_t value_hash(const entry *e) const
+    {
+        size_t size = 0;
+        const void *p = value_of(e, size);
+        if (auto *ops = ops_of(e)) return ops->hash(p);
+
+        auto *bytes = static_cast<const unsigned char *>(p);
+        if (e->flags & float_value) {
+            uint64_t h = size;
+            for (size_t i = 0; i + 4 <= size; i += 4)
+                h = mix(h ^ float_bits<float, uint32_t>(bytes + i));
+            return h;
+        }
+        if (e->flags & double_value) {
+            uint64_t h = size;
+            for (size_t i = 0; i + 8 <= size; i += 8)
+                h = mix(h ^ float_bits<double, uint64_t>(bytes + i));
+            return h;
+        }
+        return hash_bytes(p, size);
+    }
+
+    bool value_equal(const entry *a, const parameters &o,
+                     const entry *b) const
+    {
+        if ((a->flags & ~lazy) != (b->flags & ~lazy) || a->elem != b->elem)
+            return false;
+        auto *ops = ops_of(a);
+        if (ops != o.ops_of(b)) return false;
+
+        size_t size = 0, other_size = 0;
+        const void *p = value_of(a, size);
+        const void *q = o.value_of(b, other_size);
+        if (size != other_size) return false;
+        if (ops) return ops->equal(p, q);
+
+        auto *x = static_cast<const unsigned char *>(p);
+        auto *y = static_cast<const unsigned char *>(q);
+        if (a->flags & float_value) {
+            for (size_t i = 0; i + 4 <= size; i += 4) {
+                if (float_bits<float, uint32_t>(x + i) !=
+                    float_bits<float, uint32_t>(y + i))
+                    return false;
+            }
+            return true;
+        }
+        if (a->flags & double_value) {
+            for (size_t i = 0; i + 8 <= size; i += 8) {
+                if (float_bits<double, uint64_t>(x + i) !=
+                    float_bits<double, uint64_t>(y + i))
+                    return false;
+            }
+            return true;
+        }
+        return memcmp(p, q, size) == 0;
+    }
+
+    static constexpr size_t min_capacity = 256;
+
+  public:
+    /* Alignment of arrays added with add_array, fits AVX-512 loads */
+    static constexpr size_t array_align = 64;
+
+  private:
+    unsigned char *m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    size_t m_count = 0;
+    bool m_owned = false;
+    bool m_fixed = false;
+    bool m_lazy = false; /* set once a lazy value was added */
+
+    entry *entries() const
+    {
+        return reinterpret_cast<entry *>(m_data + m_capacity) - m_count;
+    }
+
+    static size_t align_up(size_t v, size_t a)
+    {
+        return (v + a - 1) & ~(a - 1);
+    }
+
+    /* Bytes needed to hold all current entries in a fresh buffer */
+    size_t footprint() const
+    {
+        size_t n = 0;
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i)
+            n += e[i].key_len + e[i].align + e[i].size + sizeof(entry);
+        return n;
+    }
+
+    const entry *find(std::string_view id, uint32_t h) const
+    {
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            if (e[i].hash == h && e[i].key_len == id.size() &&
+                memcmp(m_data + e[i].key, id.data(), id.size()) == 0)
+                return e + i;
+        }
+        return nullptr;
+    }
+
+    /* Reserves space for a new value, returns nullptr if the id exists */
+    void *insert(std::string_view id, size_t size, size_t align,
+                 const value_ops *ops, size_t elem = 0, uint16_t flags = 0)
+    {
+        uint32_t h = hash(id);
+        if (find(id, h) || size > UINT32_MAX / 2 || align > UINT16_MAX ||
+            elem > UINT16_MAX || id.size() > UINT16_MAX)
+            return nullptr;
+
+        for (;;) {
+            auto base = reinterpret_cast<uintptr_t>(m_data);
+            size_t key = m_used;
+            size_t value = align_up(base + key + id.size() + 1, align) - base;
+            size_t end = m_capacity - (m_count + 1) * sizeof(entry);
+            if (m_data && m_capacity >= (m_count + 1) * sizeof(entry) &&
+                value + size <= end) {
+                memcpy(m_data + key, id.data(), id.size());
+                m_data[key + id.size()] = '\0';
+                m_used = value + size;
+                ++m_count;
+                if (flags & lazy) m_lazy = true;
+                *entries() = {h,
+                              uint32_t(key),
+                              uint32_t(value),
+                              uint32_t(size),
+                              uint16_t(id.size()),
+                              uint16_t(align),
+                              uint16_t(elem),
+                              flags,
+                              ops};
+                return m_data + value;
+            }
+            if (m_fixed) return nullptr;
+            grow(id.size() + 1 + align + size + sizeof(entry));
+        }
+    }
+
+    /* Moves all entries into a new heap buffer with room for extra bytes */
+    void grow(size_t extra)
+    {
+        size_t cap = std::max(m_capacity * 2, footprint() + extra);
+        cap = align_up(std::max(cap, min_capacity), alignof(entry));
+
+        parameters tmp;
+        tmp.m_data = static_cast<unsigned char *>(::operator new(cap));
+        tmp.m_capacity = cap;
+        tmp.m_owned = true;
+        tmp.relocate_from(*this);
+        swap(tmp);
+    }
+
+    /* Moves the values out of o, leaving it empty with its buffer */
+    void relocate_from(parameters &o)
+    {
+        const entry *e = o.entries();
+        for (size_t i = o.m_count; i-- > 0;) {
+            std::string_view id(reinterpret_cast<const char *>(o.m_data) +
+                                    e[i].key,
+                                e[i].key_len);
+            void *src = o.m_data + e[i].value;
+            void *dst = insert(id, e[i].size, e[i].align, e[i].ops,
+                               e[i].elem, e[i].flags);
+            if (e[i].ops)
+                e[i].ops->move(dst, src);
+            else
+                memcpy(dst, src, e[i].size);
+        }
+        o.m_count = 0;
+        o.m_used = 0;
+        o.m_lazy = false;
+    }
+
+    /* Lazy values which weren't read yet are left out if skip_pending is
+     * set, their generators may refer to data the copy outlives */
+    bool copy_from(const parameters &o, bool skip_pending = false)
+    {
+        reserve(o.footprint());
+        const entry *e = o.entries();
+        for (size_t i = o.m_count; i-- > 0;) {
+            std::string_view id(reinterpret_cast<const char *>(o.m_data) +
+                                    e[i].key,
+                                e[i].key_len);
+            const void *src = o.m_data + e[i].value;
+            if (skip_pending && (e[i].flags & lazy) &&
+                !static_cast<const lazy_base *>(src)->ready)
+                continue;
+            void *dst = insert(id, e[i].size, e[i].align, e[i].ops,
+                               e[i].elem, e[i].flags);
+            if (!dst) return false;
+            if (e[i].ops)
+                e[i].ops->copy(dst, src);
+            else
+                memcpy(dst, src, e[i].size);
+        }
+        return true;
+    }
+
+    void release()
+    {
+        reset();
+        if (m_owned) ::operator delete(m_data);
+        m_data = nullptr;
+        m_capacity = 0;
+        m_owned = false;
+    }
+
+    void swap(parameters &o)
+    {
+        std::swap(m_data, o.m_data);
+        std::swap(m_capacity, o.m_capacity);
+        std::swap(m_used, o.m_used);
+        std::swap(m_count, o.m_count);
+        std::swap(m_owned, o.m_owned);
+        std::swap(m_lazy, o.m_lazy);
+    }
 
   public:
     parameters() = default;
 
-    ~parameters()
+    /**
+     * \brief Use caller provided memory to store the parameters, the list
+     * only allocates once this buffer is full. The buffer has to outlive
+     * this object
+     * \param buffer the memory to use
+     * \param size the size of the buffer in bytes
+     * \param fixed if true the list never allocates, adding values fails
+     * once the buffer is full
+     * \defgroup signal++
+     */
+    parameters(void *buffer, size_t size, bool fixed = false)
+        : m_fixed(fixed)
+    {
+        auto begin = reinterpret_cast<uintptr_t>(buffer);
+        auto end = (begin + size) & ~uintptr_t(alignof(entry) - 1);
+        if (buffer && end > begin) {
+            m_data = static_cast<unsigned char *>(buffer);
+            m_capacity = end - begin;
+        }
+    }
+
+    parameters(const parameters &o) { copy_from(o); }
+
+    /**
+     * \brief Take the heap buffer of o, values in a caller provided buffer
+     * are moved into a new heap buffer which may throw std::bad_alloc
+     * \defgroup signal++
+     */
+    parameters(parameters &&o)
+    {
+        if (o.m_owned) {
+            swap(o);
+        } else if (o.m_count) {
+            reserve(o.footprint());
+            relocate_from(o);
+        }
+    }
+
+    parameters &operator=(const parameters &o)
+    {
+        if (this != &o) assign(o);
+        return *this;
+    }
+
+    /**
+     * \brief Take the values of o like parameters(parameters &&). A fixed
+     * list keeps its buffer and copies the values instead, it is left empty
+     * if they don't fit, use assign() to check
+     * \defgroup signal++
+     */
+    parameters &operator=(parameters &&o)
+    {
+        if (m_fixed) return *this = o;
+        if (this != &o) {
+            if (o.m_owned) {
+                release();
+                swap(o);
+            } else {
+                reset();
+                reserve(o.footprint());
+                relocate_from(o);
+            }
+        }
+        return *this;
+    }
+
+    ~parameters() { release(); }
+
+    /**
+     * \brief FNV-1a hash used for parameter ids
+     * \defgroup signal++
+     */
+    static constexpr uint32_t hash(std::string_view id)
+    {
+        uint32_t h = 2166136261u;
+        for (char c : id)
+            h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+        return h;
+    }
+
+    /**
+     * \brief Calculate the buffer size needed to store parameters
+     * \param count the number of parameters
+     * \param bytes the combined length of all ids and values
+     * \param align the largest alignment of the values
+     * \return the size in bytes
+     * \defgroup signal++
+     */
+    static constexpr size_t storage_size(size_t count, size_t bytes,
+                                         size_t align = array_align)
+    {
+        return count * (sizeof(entry) + align) + bytes;
+    }
+
+    /**
+     * \brief Replace the values with copies of the values of o, reusing the
+     * memory of this list
+     * \param skip_pending leave out lazy values which weren't read yet
+     * instead of copying their generators
+     * \return false if the values don't fit into a fixed buffer, the list
+     * is empty then
+     * \defgroup signal++
+     */
+    bool assign(const parameters &o, bool skip_pending = false)
+    {
+        if (this == &o) return true;
+        reset();
+        if (copy_from(o, skip_pending)) return true;
+        reset();
+        return false;
+    }
+
+    /**
+     * \brief Add copies of the values of o whose ids aren't in this list
+     * yet, values which are already there are kept
+     * \param from the number of values of o to skip, counted from the
+     * first one added, e.g. o.size() before receivers added to it
+     * \return false if a value doesn't fit into a fixed buffer
+     * \defgroup signal++
+     */
+    bool merge(const parameters &o, size_t from = 0)
+    {
+        if (this == &o) return true;
+        const entry *e = o.entries();
+        for (size_t i = o.m_count - std::min(from, o.m_count); i-- > 0;) {
+            std::string_view id(reinterpret_cast<const char *>(o.m_data) +
+                                    e[i].key,
+                                e[i].key_len);
+            if (find(id, e[i].hash)) continue;
+            const void *src = o.m_data + e[i].value;
+            void *dst = insert(id, e[i].size, e[i].align, e[i].ops,
+                               e[i].elem, e[i].flags);
+            if (!dst) return false;
+            if (e[i].ops)
+                e[i].ops->copy(dst, src);
+            else
+                memcpy(dst, src, e[i].size);
+        }
+        return true;
+    }
+
+    /**
+     * \return true if this list never allocates, see parameters(buffer,
+     * size, fixed)
+     * \defgroup signal++
+     */
+    bool fixed() const { return m_fixed; }
+
+    /**
+     * \brief Remove all parameters but keep the allocated memory for reuse
+     * \defgroup signal++
+     */
+    void reset()
+    {
+        entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            if (e[i].ops) e[i].ops->destroy(m_data + e[i].value);
+        }
+        m_count = 0;
+        m_used = 0;
+        m_lazy = false;
+    }
+
+    /**
+     * \brief Make sure that at least bytes of keys and values can be added
+     * without allocating
+     * \param bytes the number of bytes to reserve
+     * \defgroup signal++
+     */
+    void reserve(size_t bytes)
+    {
+        if (m_fixed) return;
+        if (m_capacity - m_used - m_count * sizeof(entry) < bytes)
+            grow(bytes);
+    }
+
+    /**
+     * \return the number of parameters in this list
+     * \defgroup signal++
+     */
+    size_t size() const { return m_count; }
+
+    /**
+     * \brief Memory used by this list, caller provided buffers are not
+     * counted
+     * \return the size of this object, its buffer and memory owned by its
+     * values in bytes
+     * \defgroup signal++
+     */
+    size_t memory_usage() const
     {
-        for (auto &param : m_parameters) {
-            free(param.second.second);
-            param.second.second = nullptr;
-            param.second.first = 0;
+        size_t n = sizeof(*this) + (m_owned ? m_capacity : 0);
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            if (e[i].ops) n += e[i].ops->heap(m_data + e[i].value);
         }
+        return n;
     }
 
+    /**
+     * \return true if this list contains no parameters
+     * \defgroup signal++
+     */
+    bool empty() const { return m_count == 0; }
+
     /**
      * \brief Add any variable to the list
      * \param T the variable type
@@ -61,15 +794,35 @@ class parameters
      * \return true if the variable could be added, false if it already exists
      * \defgroup signal++
      */
-    template <class T> bool add(const std::string &id, const T &param)
+    template <class T> bool add(std::string_view id, const T &param)
     {
-        auto tmp = m_parameters.find(id);
-        if (tmp == m_parameters.end()) {
-            m_parameters[id].second = new T(param);
-            m_parameters[id].first = sizeof(T);
-            return true;
-        }
-        return false;
+        void *p = insert(id, sizeof(T), alignof(T), ops_for<T>::get(), 0,
+                         type_flags<T>());
+        if (!p) return false;
+        new (p) T(param);
+        return true;
+    }
+
+    /**
+     * \brief Add a variable which is only created when it is read for the
+     * first time. The value is kept after that, so the generator runs at
+     * most once for this list. Evaluation isn't synchronized, so a list with
+     * lazy values must not be read by several threads at the same time
+     * \param T the variable type
+     * \param id the id of the parameter
+     * \param generator a callable which returns the value
+     * \return true if the variable could be added, false if it already exists
+     * \defgroup signal++
+     */
+    template <class T, class G>
+    bool add_lazy(std::string_view id, G generator)
+    {
+        typedef lazy_value<T, G> type;
+        void *p = insert(id, sizeof(type), alignof(type),
+                         ops_for<type>::get(), 0, lazy | type_flags<T>());
+        if (!p) return false;
+        new (p) type(std::move(generator));
+        return true;
     }
 
     /**
@@ -80,249 +833,3086 @@ class parameters
      * \return true if the variable could be added, false if it already exists
      * \defgroup signal++
      */
-    bool add_direct(const std::string &id, const void *data, size_t s)
+    bool add_direct(std::string_view id, const void *data, size_t s)
+    {
+        void *p = insert(id, s, alignof(std::max_align_t), nullptr);
+        if (!p) return false;
+        memcpy(p, data, s);
+        return true;
+    }
+
+    /**
+     * \brief Add a copy of an array to the list, the copy is stored
+     * contiguously and aligned to array_align bytes so it can be used with
+     * SIMD instructions directly
+     * \param id the id of the parameter
+     * \param data the first element of the array
+     * \param count the number of elements
+     * \return true if the array could be added, false if it already exists
+     * \defgroup signal++
+     */
+    template <class T>
+    bool add_array(std::string_view id, const T *data, size_t count)
+    {
+        T *p = add_array<T>(id, count);
+        if (!p) return false;
+        if (count) memcpy(p, data, count * sizeof(T));
+        return true;
+    }
+
+    /**
+     * \brief Add an uninitialized array to the list, so it can be filled in
+     * place
+     * \param id the id of the parameter
+     * \param count the number of elements
+     * \return the first element of the array or nullptr if it already exists
+     * \defgroup signal++
+     */
+    template <class T> T *add_array(std::string_view id, size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Array elements have to be trivially copyable");
+        if (count > UINT32_MAX / sizeof(T)) return nullptr;
+        return static_cast<T *>(insert(id, count * sizeof(T),
+                                       std::max(array_align, alignof(T)),
+                                       nullptr, sizeof(T), type_flags<T>()));
+    }
+
+    /**
+     * \brief Run the generators of the lazy values which weren't read yet,
+     * so the list no longer depends on anything they capture
+     * \defgroup signal++
+     */
+    void evaluate() const
+    {
+        if (!m_lazy) return;
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            size_t size = 0;
+            if (e[i].flags & lazy) value_of(e + i, size);
+        }
+    }
+
+    /**
+     * \brief 64 bit hash of all ids and values, independent of the order the
+     * values were added in. Equal lists have equal fingerprints. Lazy
+     * values are evaluated, values which can't be hashed (no std::hash and
+     * not a string) give a new fingerprint every time
+     * \return the fingerprint
+     * \defgroup signal++
+     */
+    uint64_t fingerprint() const
+    {
+        uint64_t h = m_count;
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            uint64_t key = hash_bytes(m_data + e[i].key, e[i].key_len);
+            h += mix(key ^ value_hash(e + i));
+        }
+        return mix(h);
+    }
+
+    /**
+     * \brief Compare the ids and values of two lists, independent of the
+     * order the values were added in. Plain values are compared bytewise,
+     * floats by value with NaN equal to NaN and other values with their
+     * operator==
+     * \defgroup signal++
+     */
+    bool operator==(const parameters &o) const
+    {
+        if (m_count != o.m_count) return false;
+        const entry *e = entries();
+        for (size_t i = 0; i < m_count; ++i) {
+            std::string_view id(reinterpret_cast<const char *>(m_data) +
+                                    e[i].key,
+                                e[i].key_len);
+            const entry *other = o.find(id, e[i].hash);
+            if (!other || !value_equal(e + i, o, other)) return false;
+        }
+        return true;
+    }
+
+    bool operator!=(const parameters &o) const { return !(*this == o); }
+
+    /**
+     * \brief Get an array from the list
+     * \param id the id of the parameter
+     * \param ok will be set to true on success (optional)
+     * \return a view of the array, empty if it doesn't exist or if the
+     * size of its elements doesn't match
+     * \defgroup signal++
+     */
+    template <class T>
+    array_view<T> get_array(std::string_view id, bool *ok = nullptr) const
+    {
+        auto p = find(id, hash(id));
+        if (!p || p->elem != sizeof(T)) {
+            if (ok) *ok = false;
+            return {};
+        }
+        if (ok) *ok = true;
+        return {reinterpret_cast<const T *>(m_data + p->value),
+                p->size / sizeof(T)};
+    }
+
+    /**
+     * \brief Get a variable from the list
+     * \param id the id of the parameter
+     * \param ok will be set to true on success (optional)
+     * \param def the default return value on failure (optional)
+     * \return the value of the parameter
+     * \defgroup signal++
+     */
+    template <class T>
+    const T &get(std::string_view id, bool *ok = nullptr,
+                 const T &def = T()) const
+    {
+        auto p = find(id, hash(id));
+        size_t size = 0;
+        void *value = p ? value_of(p, size) : nullptr;
+        if (!value || sizeof(T) != size) {
+            if (ok) *ok = false;
+            return def;
+        }
+        if (ok) *ok = true;
+        return *reinterpret_cast<const T *>(value);
+    }
+
+    /**
+     * \brief Get a data pointer from the list
+     * \param id the id of the parameter
+     * \param ok will be set to true on success (optional)
+     * \param def the default return value on failure (optional)
+     * \return the value of the parameter, this is a direct pointer and should
+     * be copied \defgroup signal++
+     */
+    void *get_direct(std::string_view id, bool *ok = nullptr,
+                     void *def = nullptr) const
+    {
+        auto p = find(id, hash(id));
+        if (!p) {
+            if (ok) *ok = false;
+            return def;
+        }
+        if (ok) *ok = true;
+        size_t size = 0;
+        return value_of(p, size);
+    }
+
+    /**
+     * \brief Get a data pointer and the size of its value from the list
+     * \param id the id of the parameter
+     * \param size will be set to the size of the value in bytes
+     * \return the value of the parameter or nullptr if it doesn't exist
+     * \defgroup signal++
+     */
+    const void *get_direct(std::string_view id, size_t &size) const
+    {
+        auto p = find(id, hash(id));
+        if (!p) return nullptr;
+        return value_of(p, size);
+    }
+};
+
+/**
+ * \brief Immutable, reference counted parameters. Copies share one list, so
+ * the same parameters can be handed to several queues or threads without
+ * copying them. mutate() copies the list first if it is shared.
+ * Converts to const parameters & so it can be passed to send and receivers
+ * \class shared_parameters
+ * \defgroup signal++
+ */
+class shared_parameters
+{
+    std::shared_ptr<parameters> m_params;
+
+    static const parameters &empty()
+    {
+        static const parameters e;
+        return e;
+    }
+
+  public:
+    shared_parameters() = default;
+
+    /**
+     * \brief Take over the values of p without copying them
+     * \defgroup signal++
+     */
+    shared_parameters(parameters &&p)
+        : m_params(std::make_shared<parameters>(std::move(p)))
+    {
+    }
+
+    /**
+     * \brief Create a shared copy of p
+     * \defgroup signal++
+     */
+    explicit shared_parameters(const parameters &p)
+        : m_params(std::make_shared<parameters>(p))
+    {
+    }
+
+    const parameters &get() const { return m_params ? *m_params : empty(); }
+    operator const parameters &() const { return get(); }
+    const parameters &operator*() const { return get(); }
+    const parameters *operator->() const { return &get(); }
+
+    /**
+     * \brief Get a writable list, if other copies share the list it is
+     * copied first so they don't see the change
+     * \return the parameters owned by this object
+     * \defgroup signal++
+     */
+    parameters &mutate()
+    {
+        if (!m_params)
+            m_params = std::make_shared<parameters>();
+        else if (m_params.use_count() > 1)
+            m_params = std::make_shared<parameters>(*m_params);
+        return *m_params;
+    }
+
+    /**
+     * \return the number of objects sharing this list, 0 if it is empty
+     * \defgroup signal++
+     */
+    long use_count() const { return m_params.use_count(); }
+};
+
+/**
+ * \brief The receiver class is an interface class, which can be implemented
+ * to allow sending of signals to objects
+ * \class receiver
+ * \defgroup signal++
+ */
+class receiver
+{
+  public:
+    virtual ~receiver() = default;
+    virtual void receive(const parameters &param = parameters(),
+                         parameters *out = nullptr) = 0;
+};
+
+/**
+ * \typedef Function pointer
+ * \brief Structure for any method called by a signal
+ * \param params    Parameters sent to this method by the signal caller
+ * \param repsonse    Output data for this signal (shared by all methods)
+ * \defgroup signal++
+ */
+typedef void (*signal_function)(const parameters &param, parameters *response);
+
+/**
+ * \brief Type erased receiver, can hold a function pointer, a lambda, a bound
+ * member function or a receiver object. Callables that fit into inline_size
+ * bytes are stored without a heap allocation
+ * \class delegate
+ * \defgroup signal++
+ */
+class delegate
+{
+  public:
+    static constexpr size_t inline_size = 3 * sizeof(void *);
+
+  private:
+    enum class op { copy, move, destroy, equal, heap };
+    typedef void (*invoke_fn)(void *, const parameters &, parameters *);
+    typedef bool (*manage_fn)(op, void *, const void *);
+
+    template <class F>
+    using fits_inline = std::integral_constant<
+        bool, sizeof(F) <= inline_size && alignof(F) <= alignof(void *) &&
+                  std::is_nothrow_move_constructible<F>::value>;
+
+    /* Only function pointers and callables with a member operator== can be
+     * compared, lambdas are always treated as distinct receivers */
+    template <class F, class = void> struct comparable : std::false_type {
+    };
+    template <class F>
+    struct comparable<F, decltype(void(std::declval<const F &>().operator==(
+                             std::declval<const F &>())))> : std::true_type {
+    };
+    template <class F>
+    using is_comparable =
+        std::integral_constant<bool, std::is_pointer<F>::value ||
+                                         comparable<F>::value>;
+
+    template <class F>
+    static bool equal(const F &a, const F &b, std::true_type)
+    {
+        return a == b;
+    }
+    template <class F>
+    static bool equal(const F &, const F &, std::false_type)
+    {
+        return false;
+    }
+
+    template <class F, bool Inline = fits_inline<F>::value> struct handler {
+        static F *get(void *s) { return reinterpret_cast<F *>(s); }
+        static const F *get(const void *s)
+        {
+            return reinterpret_cast<const F *>(s);
+        }
+
+        template <class A> static void create(void *s, A &&f)
+        {
+            new (s) F(std::forward<A>(f));
+        }
+
+        static void invoke(void *s, const parameters &p, parameters *r)
+        {
+            (*get(s))(p, r);
+        }
+
+        static bool manage(op o, void *dst, const void *src)
+        {
+            switch (o) {
+            case op::copy:
+                new (dst) F(*get(src));
+                break;
+            case op::move:
+                new (dst) F(std::move(*get(const_cast<void *>(src))));
+                get(const_cast<void *>(src))->~F();
+                break;
+            case op::destroy:
+                get(dst)->~F();
+                break;
+            case op::equal:
+                return equal(*get(static_cast<const void *>(dst)), *get(src),
+                             is_comparable<F>());
+            case op::heap:
+                *static_cast<size_t *>(dst) = 0;
+                break;
+            }
+            return true;
+        }
+    };
+
+    template <class F> struct handler<F, false> {
+        static F *get(void *s) { return *reinterpret_cast<F **>(s); }
+        static const F *get(const void *s)
+        {
+            return *reinterpret_cast<F *const *>(s);
+        }
+
+        template <class A> static void create(void *s, A &&f)
+        {
+            *reinterpret_cast<F **>(s) = new F(std::forward<A>(f));
+        }
+
+        static void invoke(void *s, const parameters &p, parameters *r)
+        {
+            (*get(s))(p, r);
+        }
+
+        static bool manage(op o, void *dst, const void *src)
+        {
+            switch (o) {
+            case op::copy:
+                *reinterpret_cast<F **>(dst) = new F(*get(src));
+                break;
+            case op::move:
+                *reinterpret_cast<F **>(dst) =
+                    *reinterpret_cast<F *const *>(src);
+                break;
+            case op::destroy:
+                delete get(dst);
+                break;
+            case op::equal:
+                return equal(*get(static_cast<const void *>(dst)), *get(src),
+                             is_comparable<F>());
+            case op::heap:
+                *static_cast<size_t *>(dst) = sizeof(F);
+                break;
+            }
+            return true;
+        }
+    };
+
+    template <class T, class M> struct member_binding {
+        T *obj;
+        M method;
+
+        void operator()(const parameters &p, parameters *r) const
+        {
+            (obj->*method)(p, r);
+        }
+
+        bool operator==(const member_binding &o) const
+        {
+            return obj == o.obj && method == o.method;
+        }
+    };
+
+    struct object_binding {
+        std::shared_ptr<receiver> obj;
+
+        void operator()(const parameters &p, parameters *r) const
+        {
+            obj->receive(p, r);
+        }
+
+        bool operator==(const object_binding &o) const
+        {
+            return obj == o.obj;
+        }
+    };
+
+    template <class F> void assign(F &&f)
+    {
+        typedef typename std::decay<F>::type type;
+        handler<type>::create(&m_storage, std::forward<F>(f));
+        m_invoke = &handler<type>::invoke;
+        m_manage = &handler<type>::manage;
+    }
+
+    alignas(void *) mutable unsigned char m_storage[inline_size];
+    invoke_fn m_invoke = nullptr;
+    manage_fn m_manage = nullptr;
+
+  public:
+    delegate() = default;
+
+    /**
+     * \brief Wraps a plain receiver function, nullptr creates an empty
+     * delegate
+     * \param f the receiver function
+     * \defgroup signal++
+     */
+    delegate(signal_function f)
+    {
+        if (f) assign(f);
+    }
+
+    /**
+     * \brief Wraps a receiver object, the delegate shares ownership of it
+     * \param r the receiver object
+     * \defgroup signal++
+     */
+    template <class R, class = typename std::enable_if<
+                           std::is_base_of<receiver, R>::value>::type>
+    delegate(std::shared_ptr<R> r)
+    {
+        if (r) assign(object_binding{std::move(r)});
+    }
+
+    /**
+     * \brief Wraps any callable with the signature of signal_function, e.g.
+     * a lambda with captures
+     * \param f the callable
+     * \defgroup signal++
+     */
+    template <class F, class D = typename std::decay<F>::type,
+              class = typename std::enable_if<
+                  !std::is_same<D, delegate>::value>::type,
+              class = decltype(std::declval<D &>()(
+                  std::declval<const parameters &>(),
+                  std::declval<parameters *>()))>
+    delegate(F &&f)
+    {
+        assign(std::forward<F>(f));
+    }
+
+    /**
+     * \brief Binds a member function to an object, the object has to outlive
+     * this delegate
+     * \param obj the object to call the method on
+     * \param method the member function
+     * \defgroup signal++
+     */
+    template <class T>
+    delegate(T *obj, void (T::*method)(const parameters &, parameters *))
+    {
+        if (obj && method)
+            assign(member_binding<T, decltype(method)>{obj, method});
+    }
+
+    template <class T>
+    delegate(const T *obj,
+             void (T::*method)(const parameters &, parameters *) const)
+    {
+        if (obj && method)
+            assign(member_binding<const T, decltype(method)>{obj, method});
+    }
+
+    delegate(const delegate &o) : m_invoke(o.m_invoke), m_manage(o.m_manage)
+    {
+        if (m_manage) m_manage(op::copy, &m_storage, &o.m_storage);
+    }
+
+    delegate(delegate &&o) noexcept
+        : m_invoke(o.m_invoke), m_manage(o.m_manage)
+    {
+        if (m_manage) m_manage(op::move, &m_storage, &o.m_storage);
+        o.m_invoke = nullptr;
+        o.m_manage = nullptr;
+    }
+
+    delegate &operator=(const delegate &o)
+    {
+        if (this != &o) {
+            delegate tmp(o);
+            *this = std::move(tmp);
+        }
+        return *this;
+    }
+
+    delegate &operator=(delegate &&o) noexcept
+    {
+        if (this != &o) {
+            reset();
+            m_invoke = o.m_invoke;
+            m_manage = o.m_manage;
+            if (m_manage) m_manage(op::move, &m_storage, &o.m_storage);
+            o.m_invoke = nullptr;
+            o.m_manage = nullptr;
+        }
+        return *this;
+    }
+
+    ~delegate() { reset(); }
+
+    /**
+     * \brief Destroys the wrapped callable and leaves this delegate empty
+     * \defgroup signal++
+     */
+    void reset()
+    {
+        if (m_manage) m_manage(op::destroy, &m_storage, nullptr);
+        m_invoke = nullptr;
+        m_manage = nullptr;
+    }
+
+    explicit operator bool() const { return m_invoke != nullptr; }
+
+    void operator()(const parameters &param, parameters *response) const
+    {
+        m_invoke(&m_storage, param, response);
+    }
+
+    /**
+     * \brief Two delegates are equal if they wrap the same function pointer,
+     * the same receiver object or the same member function of the same object
+     * \defgroup signal++
+     */
+    bool operator==(const delegate &o) const
+    {
+        if (m_invoke != o.m_invoke) return false;
+        if (!m_invoke) return true;
+        return m_manage(op::equal, &m_storage, &o.m_storage);
+    }
+
+    bool operator!=(const delegate &o) const { return !(*this == o); }
+
+    /**
+     * \return the heap memory used by the wrapped callable in bytes, zero if
+     * it is stored inline
+     * \defgroup signal++
+     */
+    size_t heap_size() const
+    {
+        size_t n = 0;
+        if (m_manage) m_manage(op::heap, &n, &m_storage);
+        return n;
+    }
+};
+
+/**
+ * \brief Limits how many sends of a signal reach its receivers, sends
+ * beyond the limit are dropped before any receiver runs
+ * \struct send_policy
+ * \defgroup signal++
+ */
+struct send_policy {
+    enum kind_t { none, rate_limit, every_nth, min_interval } kind = none;
+    double rate = 0;    /* rate_limit: sends per second */
+    uint32_t burst = 1; /* rate_limit: sends allowed at once */
+    uint32_t n = 1;     /* every_nth: keep every nth send */
+    std::chrono::nanoseconds interval{0}; /* min_interval */
+
+    /**
+     * \brief Token bucket which allows per_second sends on average and up
+     * to burst sends at once
+     * \defgroup signal++
+     */
+    static send_policy limit(double per_second, uint32_t burst = 1)
+    {
+        send_policy p;
+        p.kind = rate_limit;
+        p.rate = per_second;
+        p.burst = std::max(burst, 1u);
+        return p;
+    }
+
+    /**
+     * \brief Keep the first and then every nth send
+     * \defgroup signal++
+     */
+    static send_policy every(uint32_t n)
+    {
+        send_policy p;
+        p.kind = every_nth;
+        p.n = std::max(n, 1u);
+        return p;
+    }
+
+    /**
+     * \brief Drop sends which happen less than min after the last kept one
+     * \defgroup signal++
+     */
+    static send_policy at_most_every(std::chrono::nanoseconds min)
+    {
+        send_policy p;
+        p.kind = min_interval;
+        p.interval = min;
+        return p;
+    }
+};
+
+/**
+ * \brief Counters of a signal, see manager::stats
+ * \struct signal_stats
+ * \defgroup signal++
+ */
+struct signal_stats {
+    static constexpr size_t latency_buckets = 16;
+
+    uint64_t dropped = 0;    /* sends dropped by the send_policy */
+    uint64_t suppressed = 0; /* unchanged sends of a distinct signal */
+    uint64_t muted = 0;      /* sends while a group of the signal was muted */
+    uint64_t receivers = 0;  /* registered receivers */
+
+    /* Only counted after manager::set_counters() */
+    uint64_t sends = 0;  /* sends which reached the signal */
+    uint64_t misses = 0; /* sends to a signal without receivers */
+
+    /* Sends of a memoized signal answered from its cache or not */
+    uint64_t cache_hits = 0;
+    uint64_t cache_misses = 0;
+
+    /* Sampled send durations, bucket i counts sends which took less than
+     * 2^(i + 8) ns, the last bucket counts all longer sends */
+    uint64_t latency[latency_buckets] = {};
+};
+
+/**
+ * \brief Priority class of a send queued by manager::post(), the queues of
+ * the classes are drained strictly in this order
+ * \enum post_class
+ * \defgroup signal++
+ */
+enum class post_class : uint8_t { critical, high, normal, bulk };
+
+static constexpr size_t post_classes = 4;
+
+/**
+ * \brief How a send queued by manager::post() is scheduled
+ * \struct post_options
+ * \defgroup signal++
+ */
+struct post_options {
+    typedef std::chrono::steady_clock clock;
+
+    post_class priority = post_class::normal;
+    /* The send is dropped if it can't run before this time */
+    clock::time_point deadline = clock::time_point::max();
+    /* How long post() waits for room if the queue of the class is full */
+    std::chrono::nanoseconds wait{0};
+
+    /**
+     * \brief A send of the given class without a deadline
+     * \defgroup signal++
+     */
+    static post_options of(post_class priority)
+    {
+        post_options o;
+        o.priority = priority;
+        return o;
+    }
+
+    /**
+     * \brief A send of the given class which has to run within budget,
+     * e.g. within(post_class::critical, std::chrono::milliseconds(5))
+     * \defgroup signal++
+     */
+    static post_options within(post_class priority,
+                               std::chrono::nanoseconds budget)
+    {
+        post_options o;
+        o.priority = priority;
+        o.deadline = clock::now() + budget;
+        return o;
+    }
+};
+
+/**
+ * \brief Counters of the queue of one post_class
+ * \struct post_queue_stats
+ * \defgroup signal++
+ */
+struct post_queue_stats {
+    size_t queued = 0;     /* sends waiting in the queue */
+    size_t limit = 0;      /* the most sends the queue holds */
+    uint64_t expired = 0;  /* sends dropped after their deadline */
+    uint64_t rejected = 0; /* posts which failed because it was full */
+};
+
+/**
+ * \brief Enforces a send_policy, every check is a load and at most one
+ * compare and swap
+ * \class limiter
+ * \defgroup signal++
+ */
+class limiter
+{
+    send_policy m_policy;
+    int64_t m_step;                  /* nanoseconds per token */
+    int64_t m_tolerance;             /* burst in nanoseconds */
+    std::atomic<int64_t> m_next{0};  /* earliest time of the next send */
+    std::atomic<uint64_t> m_count{0};
+    std::atomic<uint64_t> m_dropped{0};
+
+    static int64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /* Generic cell rate algorithm, m_next is the theoretical arrival time */
+    bool admit_rate()
+    {
+        int64_t t = now();
+        int64_t next = m_next.load(std::memory_order_relaxed);
+        for (;;) {
+            int64_t base = std::max(next, t);
+            if (base - t > m_tolerance) return false;
+            if (m_next.compare_exchange_weak(next, base + m_step,
+                                             std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+    bool admit_interval()
+    {
+        int64_t t = now();
+        int64_t next = m_next.load(std::memory_order_relaxed);
+        for (;;) {
+            if (t < next) return false;
+            if (m_next.compare_exchange_weak(next, t + m_step,
+                                             std::memory_order_relaxed))
+                return true;
+        }
+    }
+
+  public:
+    explicit limiter(const send_policy &p) : m_policy(p)
+    {
+        if (p.kind == send_policy::rate_limit && p.rate > 0)
+            m_step = int64_t(1e9 / p.rate);
+        else
+            m_step = int64_t(p.interval.count());
+        m_tolerance = m_step * (int64_t(p.burst) - 1);
+    }
+
+    const send_policy &policy() const { return m_policy; }
+    uint64_t dropped() const { return m_dropped.load(); }
+
+    /**
+     * \return true if the send may reach the receivers
+     * \defgroup signal++
+     */
+    bool admit()
+    {
+        bool ok = true;
+        switch (m_policy.kind) {
+        case send_policy::rate_limit:
+            ok = admit_rate();
+            break;
+        case send_policy::every_nth:
+            ok = m_count.fetch_add(1, std::memory_order_relaxed) %
+                     m_policy.n ==
+                 0;
+            break;
+        case send_policy::min_interval:
+            ok = admit_interval();
+            break;
+        case send_policy::none:
+            break;
+        }
+        if (!ok) m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return ok;
+    }
+};
+
+/**
+ * \brief The signal class holds all receivers for this signal in one
+ * contiguous list of delegates
+ * \class signal
+ * \defgroup signal++
+ */
+class signal
+{
+    /* Receivers which are only called if a parameter has a certain value */
+    struct filter_index {
+        std::string key;
+        size_t size;
+        std::unordered_map<uint64_t, std::vector<delegate>> receivers;
+    };
+
+    std::vector<delegate> m_receivers;
+    std::vector<filter_index> m_filters;
+    std::unique_ptr<limiter> m_limiter;
+#ifdef LIBSIGNAL_TRACE
+    const char *m_trace_name = "";
+#endif
+
+    /* Last parameters sent on a sticky signal */
+    struct sticky_value {
+        std::mutex lock;
+        shared_parameters last;
+        bool set = false;
+        bool evaluate = true;
+    };
+    std::unique_ptr<sticky_value> m_sticky;
+
+    /* Fingerprint of the last send on a distinct signal */
+    struct distinct_state {
+        std::atomic<uint64_t> last{0};
+        std::atomic<bool> seen{false};
+        std::atomic<uint64_t> suppressed{0};
+    };
+    std::unique_ptr<distinct_state> m_distinct;
+
+    /* Counters of manager::send, see manager::set_counters() */
+    struct send_counters {
+        std::atomic<uint64_t> sends{0}, misses{0};
+        std::atomic<uint64_t> latency[signal_stats::latency_buckets] = {};
+
+        static uint64_t now()
+        {
+            return uint64_t(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count());
+        }
+    };
+    std::unique_ptr<send_counters> m_counters;
+
+    /* Responses of a memoized signal by the fingerprint of their input,
+     * the front of the list was used last */
+    struct memo_cache {
+        struct entry {
+            uint64_t fingerprint;
+            parameters input, response;
+        };
+
+        std::mutex lock;
+        size_t capacity;
+        std::list<entry> lru;
+        std::unordered_map<uint64_t, std::list<entry>::iterator> index;
+        uint64_t hits = 0, misses = 0;
+
+        explicit memo_cache(size_t size) : capacity(size) {}
+    };
+    std::unique_ptr<memo_cache> m_memo;
+
+    /* Groups of this signal for manager::mute(), the counter only exists
+     * while the signal is in a group */
+    uint64_t m_groups = 0;
+    std::unique_ptr<std::atomic<uint64_t>> m_muted;
+
+    /* Signals sent after this one, see manager::connect() */
+    struct route {
+        std::string target;
+        delegate transform;
+    };
+    std::vector<route> m_routes;
+
+  public:
+    /* One send of the flattened routes, the parameters of a step are kept
+     * in a scratch slot if it has a transform. skip is the number of steps
+     * which follow from this one, they are skipped if the send is dropped */
+    struct plan_step {
+        const signal *target;
+        const delegate *transform;
+        uint32_t input, output, skip;
+    };
+
+  private:
+    std::vector<plan_step> m_plan;
+    uint32_t m_plan_slots = 0;
+
+    /* Parameters produced by transforms, the slots are reused by all plans
+     * run on a thread. A deque keeps them in place while nested sends add
+     * more slots */
+    struct plan_scratch {
+        std::deque<parameters> slots;
+        size_t used = 0;
+
+        static plan_scratch &get()
+        {
+            static thread_local plan_scratch s;
+            return s;
+        }
+    };
+
+    /* Lazy values are evaluated first or left out, their generators
+     * usually capture locals of the sender which are gone when the value
+     * is replayed. evaluate() returns at once for lists without them */
+    void store(const parameters &param) const
+    {
+        const bool evaluate = m_sticky->evaluate;
+        if (evaluate) param.evaluate();
+        std::lock_guard<std::mutex> lock(m_sticky->lock);
+        /* Reuse the list unless a last() snapshot still holds it */
+        if (m_sticky->last.use_count() == 1) {
+            m_sticky->last.mutate().assign(param, !evaluate);
+        } else {
+            parameters copy;
+            copy.assign(param, !evaluate);
+            m_sticky->last = shared_parameters(std::move(copy));
+        }
+        m_sticky->set = true;
+    }
+
+    template <class T> static uint64_t filter_value(const T &value)
+    {
+        static_assert(sizeof(T) <= sizeof(uint64_t) &&
+                          std::is_trivially_copyable<T>::value,
+                      "Filter values have to be plain values of up to "
+                      "eight bytes");
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(T));
+        return bits;
+    }
+
+    static void call(const std::vector<delegate> &list, const char *name,
+                     size_t index, const parameters &param,
+                     parameters *response)
+    {
+#ifdef LIBSIGNAL_TRACE
+        auto &t = trace::tracer::get();
+        if (t.enabled()) {
+            uint64_t begin = t.now();
+            for (const auto &recv : list) {
+                recv(param, response);
+                uint64_t end = t.now();
+                t.record(name, trace::kind::receiver, begin, end,
+                         uint32_t(index++));
+                begin = end;
+            }
+            return;
+        }
+#endif
+        (void)name;
+        (void)index;
+        for (const auto &recv : list)
+            recv(param, response);
+    }
+
+  public:
+    signal() = default;
+
+    /**
+     * \brief Adds d as the first receiver
+     * \param d the first receiver for this signal, can be empty
+     * \defgroup signal++
+     */
+    signal(delegate d)
+    {
+        if (d) m_receivers.emplace_back(std::move(d));
+    }
+
+    /**
+     * \brief Adds r as the first receiver object
+     * \param r the first receiver object for this signal
+     * \defgroup signal++
+     */
+    signal(receiver *r)
+    {
+        if (r) m_receivers.emplace_back(std::shared_ptr<receiver>(r));
+    }
+
+    /**
+     * \brief Copies the receivers and the send policy, the counters of the
+     * copy start at zero
+     * \defgroup signal++
+     */
+    signal(const signal &o)
+        : m_receivers(o.m_receivers), m_filters(o.m_filters)
+#ifdef LIBSIGNAL_TRACE
+          ,
+          m_trace_name(o.m_trace_name)
+#endif
+          ,
+          m_routes(o.m_routes)
+    {
+        if (o.m_limiter) set_policy(o.m_limiter->policy());
+        if (o.m_sticky) {
+            set_sticky(true, o.m_sticky->evaluate);
+            std::lock_guard<std::mutex> lock(o.m_sticky->lock);
+            m_sticky->last = o.m_sticky->last;
+            m_sticky->set = o.m_sticky->set;
+        }
+        set_distinct(o.distinct());
+        set_counters(o.m_counters != nullptr);
+        set_memoize(o.m_memo ? o.m_memo->capacity : 0);
+        set_groups(o.m_groups);
+    }
+
+    signal(signal &&) = default;
+
+    signal &operator=(const signal &o)
+    {
+        if (this != &o) *this = signal(o);
+        return *this;
+    }
+
+    signal &operator=(signal &&) = default;
+
+    /**
+     * \brief Invoke this signal
+     * \param param the paramters to send to the receivers (optional)
+     * \param response the response used by the receivers (shared by all
+     * receivers) (optional) \defgroup signal++
+     */
+    void invoke(const parameters &param = parameters(),
+                parameters *response = nullptr) const
+    {
+#ifdef LIBSIGNAL_TRACE
+        const char *name = m_trace_name;
+#else
+        const char *name = nullptr;
+#endif
+        call(m_receivers, name, 0, param, response);
+
+        size_t index = m_receivers.size();
+        for (const auto &filter : m_filters) {
+            size_t size = 0;
+            auto *value = param.get_direct(filter.key, size);
+            if (!value || size != filter.size) continue;
+
+            uint64_t bits = 0;
+            memcpy(&bits, value, size);
+            auto match = filter.receivers.find(bits);
+            if (match == filter.receivers.end()) continue;
+            call(match->second, name, index, param, response);
+            index += match->second.size();
+        }
+
+        /* Stored after the receivers ran, so lazy values they read are
+         * kept even if they aren't evaluated by store() */
+        if (m_sticky) store(param);
+    }
+
+#ifdef LIBSIGNAL_TRACE
+    const char *trace_name() const { return m_trace_name; }
+    void set_trace_name(std::string_view name)
+    {
+        m_trace_name = trace::tracer::get().intern(name);
+    }
+#endif
+
+    /**
+     * \brief Add a receiver for this signal
+     * \param d the receiver
+     * \return true if the receiver could be added, false if it is empty or
+     * already registered \defgroup signal++
+     */
+    bool add_receiver(delegate d)
+    {
+        if (!d) return false;
+        if (std::find(m_receivers.begin(), m_receivers.end(), d) ==
+            m_receivers.end()) {
+            m_receivers.emplace_back(std::move(d));
+
+            bool ok = false;
+            auto value = last(&ok);
+            if (ok) m_receivers.back()(*value, nullptr);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * \brief Send the signals connected to this one, see manager::connect()
+     * \param param the parameters this signal was sent with
+     * \param response the response shared by all receivers (optional)
+     * \param muted the groups muted in the manager, see manager::mute()
+     * \defgroup signal++
+     */
+    void run_plan(const parameters &param, parameters *response,
+                  uint64_t muted = 0) const
+    {
+        if (m_plan.empty()) return;
+
+        auto &scratch = plan_scratch::get();
+        struct release {
+            plan_scratch &scratch;
+            size_t base;
+            ~release() { scratch.used = base; }
+        } slots{scratch, scratch.used};
+        scratch.used += m_plan_slots;
+        while (scratch.slots.size() < scratch.used)
+            scratch.slots.emplace_back();
+
+        auto slot = [&](uint32_t index) -> parameters & {
+            return scratch.slots[slots.base + index - 1];
+        };
+        for (size_t i = 0; i < m_plan.size(); i++) {
+            const auto &step = m_plan[i];
+            if ((muted && step.target->muted(muted)) ||
+                !step.target->admit()) {
+                i += step.skip;
+                continue;
+            }
+
+            const parameters &in = step.input ? slot(step.input) : param;
+            const parameters *out = &in;
+            if (*step.transform) {
+                out = &slot(step.output);
+                slot(step.output).reset();
+                (*step.transform)(in, &slot(step.output));
+            }
+            if (!step.target->changed(*out)) {
+                i += step.skip;
+                continue;
+            }
+
+            /* Forwarded sends are counted like direct ones, the timed
+             * duration only covers the receivers of the target */
+            const uint64_t start = step.target->count_send();
+            {
+#ifdef LIBSIGNAL_TRACE
+                trace::scope span(step.target->trace_name(),
+                                  trace::kind::send);
+#endif
+                step.target->invoke(*out, response);
+            }
+            if (start) step.target->count_latency(start);
+        }
+    }
+
+    /**
+     * \brief Add a signal which is sent after this one
+     * \param target the id of the signal
+     * \param transform fills the response parameters with the parameters of
+     * the target from the parameters of this signal, if it is empty the
+     * parameters are passed on unchanged
+     * \return false if the route already exists
+     * \defgroup signal++
+     */
+    bool add_route(std::string_view target, delegate transform)
+    {
+        for (const auto &r : m_routes) {
+            if (r.target == target && r.transform == transform)
+                return false;
+        }
+        m_routes.push_back({std::string(target), std::move(transform)});
+        return true;
+    }
+
+    /**
+     * \brief Replace the flattened routes, see manager::connect()
+     * \param plan the steps in the order they are run
+     * \param slots the number of scratch parameters used by the steps
+     * \defgroup signal++
+     */
+    void set_plan(std::vector<plan_step> plan, uint32_t slots)
+    {
+        m_plan = std::move(plan);
+        m_plan_slots = slots;
+    }
+
+    /**
+     * \brief Flatten the routes of this signal and the signals they lead to
+     * \param find returns the signal of an id
+     * \param input the scratch slot of the parameters sent to this signal
+     * \param plan the steps are added to this list
+     * \param slots the number of used scratch slots
+     * \defgroup signal++
+     */
+    template <class F>
+    void flatten_routes(const F &find, uint32_t input,
+                        std::vector<plan_step> &plan, uint32_t &slots) const
+    {
+        for (const auto &r : m_routes) {
+            const signal *target = find(r.target);
+            if (!target) continue;
+
+            const size_t at = plan.size();
+            const uint32_t output = r.transform ? input + 1 : input;
+            slots = std::max(slots, output);
+            plan.push_back({target, &r.transform, input, output, 0});
+            target->flatten_routes(find, output, plan, slots);
+            plan[at].skip = uint32_t(plan.size() - at - 1);
+        }
+    }
+
+    /**
+     * \brief Check if sending this signal leads to another one
+     * \param find returns the signal of an id
+     * \param target the other signal
+     * \defgroup signal++
+     */
+    template <class F>
+    bool routes_to(const F &find, const signal *target) const
+    {
+        if (this == target) return true;
+        for (const auto &r : m_routes) {
+            const signal *next = find(r.target);
+            if (next && next->routes_to(find, target)) return true;
+        }
+        return false;
+    }
+
+    /**
+     * \return true if other signals are sent after this one
+     * \defgroup signal++
+     */
+    bool has_routes() const { return !m_routes.empty(); }
+
+    /**
+     * \brief Remove a receiver, filtered receivers included
+     * \param d a receiver equal to the one to remove, lambdas without an
+     * operator== can't be compared and therefore not removed
+     * \return true if the receiver was found
+     * \defgroup signal++
+     */
+    bool remove_receiver(const delegate &d)
+    {
+        auto it = std::find(m_receivers.begin(), m_receivers.end(), d);
+        if (it != m_receivers.end()) {
+            m_receivers.erase(it);
+            return true;
+        }
+
+        bool found = false;
+        for (auto &filter : m_filters) {
+            for (auto bucket = filter.receivers.begin();
+                 bucket != filter.receivers.end();) {
+                auto &list = bucket->second;
+                auto match = std::find(list.begin(), list.end(), d);
+                if (match != list.end()) {
+                    list.erase(match);
+                    found = true;
+                }
+                if (list.empty())
+                    bucket = filter.receivers.erase(bucket);
+                else
+                    ++bucket;
+            }
+        }
+        return found;
+    }
+
+    /**
+     * \brief Add a receiver object for this signal using a shared pointer
+     * to ensure that the object exists for as long as this signal does
+     * \param r the receiver object
+     * \return true if the receiver object could be added, false if it is
+     * already registered \defgroup signal++
+     */
+    bool add_receiver_obj(std::shared_ptr<receiver> &&r)
+    {
+        return add_receiver(std::move(r));
+    }
+
+    /**
+     * \brief Set the policy which limits the sends of this signal, this must
+     * not be called while the signal is sent from another thread
+     * \defgroup signal++
+     */
+    void set_policy(const send_policy &policy)
+    {
+        if (policy.kind == send_policy::none)
+            m_limiter.reset();
+        else
+            m_limiter.reset(new limiter(policy));
+    }
+
+    /**
+     * \brief Make this signal keep the parameters of the last send and pass
+     * them to receivers added later, this must not be called while the
+     * signal is sent from another thread
+     * \param sticky false removes the stored parameters
+     * \param evaluate run the generators of lazy values before they are
+     * stored, if false lazy values no receiver read are not stored
+     * \defgroup signal++
+     */
+    void set_sticky(bool sticky, bool evaluate = true)
+    {
+        if (!sticky)
+            m_sticky.reset();
+        else if (!m_sticky)
+            m_sticky.reset(new sticky_value);
+        if (m_sticky) m_sticky->evaluate = evaluate;
+    }
+
+    /**
+     * \return true if this signal keeps the last parameters
+     * \defgroup signal++
+     */
+    bool sticky() const { return m_sticky != nullptr; }
+
+    /**
+     * \param ok will be set to true if the signal is sticky and was sent at
+     * least once (optional)
+     * \return the parameters of the last send, they are not changed by
+     * later sends
+     * \defgroup signal++
+     */
+    shared_parameters last(bool *ok = nullptr) const
+    {
+        if (ok) *ok = false;
+        if (!m_sticky) return shared_parameters();
+        std::lock_guard<std::mutex> lock(m_sticky->lock);
+        if (ok) *ok = m_sticky->set;
+        return m_sticky->last;
+    }
+
+    /**
+     * \return true if a send may reach the receivers, false if the send
+     * policy drops it
+     * \defgroup signal++
+     */
+    bool admit() const { return !m_limiter || m_limiter->admit(); }
+
+    /**
+     * \brief Make this signal skip sends with the same parameters as the
+     * previous send, this must not be called while the signal is sent from
+     * another thread
+     * \defgroup signal++
+     */
+    void set_distinct(bool distinct)
+    {
+        if (!distinct)
+            m_distinct.reset();
+        else if (!m_distinct)
+            m_distinct.reset(new distinct_state);
+    }
+
+    /**
+     * \return true if unchanged sends are skipped
+     * \defgroup signal++
+     */
+    bool distinct() const { return m_distinct != nullptr; }
+
+    /**
+     * \brief Remember the fingerprint of param on a distinct signal
+     * \return false if the signal is distinct and param has the same
+     * fingerprint as the previous send, true otherwise
+     * \defgroup signal++
+     */
+    bool changed(const parameters &param) const
+    {
+        if (!m_distinct) return true;
+        uint64_t fingerprint = param.fingerprint();
+        uint64_t previous =
+            m_distinct->last.exchange(fingerprint, std::memory_order_relaxed);
+        if (m_distinct->seen.exchange(true, std::memory_order_relaxed) &&
+            previous == fingerprint) {
+            m_distinct->suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * \return the counters of this signal
+     * \defgroup signal++
+     */
+    signal_stats stats() const
+    {
+        signal_stats s;
+        if (m_limiter) s.dropped = m_limiter->dropped();
+        if (m_distinct)
+            s.suppressed =
+                m_distinct->suppressed.load(std::memory_order_relaxed);
+        s.receivers = m_receivers.size();
+        for (const auto &filter : m_filters) {
+            for (const auto &list : filter.receivers)
+                s.receivers += list.second.size();
+        }
+        if (m_muted) s.muted = m_muted->load(std::memory_order_relaxed);
+        if (m_memo) {
+            std::lock_guard<std::mutex> lock(m_memo->lock);
+            s.cache_hits = m_memo->hits;
+            s.cache_misses = m_memo->misses;
+        }
+        if (m_counters) {
+            s.sends = m_counters->sends.load(std::memory_order_relaxed);
+            s.misses = m_counters->misses.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < signal_stats::latency_buckets; i++)
+                s.latency[i] =
+                    m_counters->latency[i].load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+    /**
+     * \brief Set the groups of this signal, this must not be called while
+     * the signal is sent from another thread
+     * \param groups one bit per group, zero removes the signal from all
+     * groups
+     * \defgroup signal++
+     */
+    void set_groups(uint64_t groups)
+    {
+        m_groups = groups;
+        if (!groups)
+            m_muted.reset();
+        else if (!m_muted)
+            m_muted.reset(new std::atomic<uint64_t>(0));
+    }
+
+    /**
+     * \return the groups of this signal, one bit per group
+     * \defgroup signal++
+     */
+    uint64_t groups() const { return m_groups; }
+
+    /**
+     * \brief Check the groups of this signal against the muted groups and
+     * count the send if one of them is muted
+     * \return true if the send has to be skipped
+     * \defgroup signal++
+     */
+    bool muted(uint64_t muted_groups) const
+    {
+        if (!(m_groups & muted_groups)) return false;
+        m_muted->fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * \brief Cache the responses of this signal by its input parameters,
+     * this must not be called while the signal is sent from another thread
+     * \param capacity the most responses which are kept, the least
+     * recently used one is replaced. Zero removes the cache
+     * \defgroup signal++
+     */
+    void set_memoize(size_t capacity)
+    {
+        if (!capacity)
+            m_memo.reset();
+        else if (!m_memo || m_memo->capacity != capacity)
+            m_memo.reset(new memo_cache(capacity));
+    }
+
+    /**
+     * \return true if responses are cached
+     * \defgroup signal++
+     */
+    bool memoized() const { return m_memo != nullptr; }
+
+    /**
+     * \brief Remove all cached responses
+     * \defgroup signal++
+     */
+    void invalidate() const
+    {
+        if (!m_memo) return;
+        std::lock_guard<std::mutex> lock(m_memo->lock);
+        m_memo->lru.clear();
+        m_memo->index.clear();
+    }
+
+    /**
+     * \brief Look up the cached response of a memoized signal
+     * \param param the input parameters
+     * \param response the cached values are added to it on a hit
+     * \param fingerprint set to the fingerprint of param, pass it on to
+     * remember() after a miss
+     * \return true on a hit
+     * \defgroup signal++
+     */
+    bool recall(const parameters &param, parameters &response,
+                uint64_t &fingerprint) const
+    {
+        fingerprint = param.fingerprint();
+        std::lock_guard<std::mutex> lock(m_memo->lock);
+        auto hit = m_memo->index.find(fingerprint);
+        if (hit == m_memo->index.end() || hit->second->input != param) {
+            m_memo->misses++;
+            return false;
+        }
+        m_memo->hits++;
+        m_memo->lru.splice(m_memo->lru.begin(), m_memo->lru, hit->second);
+        response.merge(hit->second->response);
+        return true;
+    }
+
+    /**
+     * \brief Cache the response to param, the oldest entry is reused once
+     * the cache is full
+     * \param from the size of response before the receivers ran, only the
+     * values they added are cached
+     * \defgroup signal++
+     */
+    void remember(uint64_t fingerprint, const parameters &param,
+                  const parameters &response, size_t from) const
+    {
+        std::lock_guard<std::mutex> lock(m_memo->lock);
+        auto &lru = m_memo->lru;
+        auto &index = m_memo->index;
+        auto it = index.find(fingerprint);
+        if (it == index.end()) {
+            if (lru.size() < m_memo->capacity) {
+                lru.emplace_front();
+            } else {
+                index.erase(lru.back().fingerprint);
+                lru.splice(lru.begin(), lru, std::prev(lru.end()));
+            }
+            it = index.emplace(fingerprint, lru.begin()).first;
+        } else {
+            lru.splice(lru.begin(), lru, it->second);
+        }
+        it->second->fingerprint = fingerprint;
+        it->second->input = param;
+        it->second->response.reset();
+        it->second->response.merge(response, from);
+    }
+
+    /**
+     * \brief Count the sends of this signal, this must not be called while
+     * the signal is sent from another thread
+     * \defgroup signal++
+     */
+    void set_counters(bool enabled)
+    {
+        if (!enabled)
+            m_counters.reset();
+        else if (!m_counters)
+            m_counters.reset(new send_counters);
+    }
+
+    /**
+     * \brief Count a send if counters are enabled. Every 16th send is timed
+     * \return the start time of a timed send in ns, zero otherwise
+     * \defgroup signal++
+     */
+    uint64_t count_send() const
+    {
+        if (!m_counters) return 0;
+        auto n = m_counters->sends.fetch_add(1, std::memory_order_relaxed);
+        if (!has_receivers())
+            m_counters->misses.fetch_add(1, std::memory_order_relaxed);
+        if (n % 16) return 0;
+        return send_counters::now() | 1;
+    }
+
+    /**
+     * \brief Add the duration of a send timed by count_send()
+     * \defgroup signal++
+     */
+    void count_latency(uint64_t start) const
+    {
+        uint64_t ns = send_counters::now() - start;
+        size_t bucket = 0;
+        while (bucket + 1 < signal_stats::latency_buckets &&
+               ns >= (uint64_t(1) << (bucket + 8)))
+            bucket++;
+        m_counters->latency[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * \return true if at least one receiver is registered
+     * \defgroup signal++
+     */
+    bool has_receivers() const
+    {
+        if (!m_receivers.empty()) return true;
+        for (const auto &filter : m_filters) {
+            if (!filter.receivers.empty()) return true;
+        }
+        return false;
+    }
+
+    /**
+     * \brief Add a receiver which is only called if the parameter key has
+     * the given value. Values are compared bytewise, so the type of value
+     * has to match the type of the parameter
+     * \param key the id of the parameter to check
+     * \param value the value the parameter needs to have
+     * \param d the receiver
+     * \return true if the receiver could be added, false if it is empty or
+     * already registered for this value \defgroup signal++
+     */
+    template <class T>
+    bool add_filtered(std::string_view key, const T &value, delegate d)
+    {
+        if (!d) return false;
+        auto filter = std::find_if(
+            m_filters.begin(), m_filters.end(), [key](const filter_index &f) {
+                return f.key == key && f.size == sizeof(T);
+            });
+        if (filter == m_filters.end())
+            filter = m_filters.insert(m_filters.end(),
+                                      {std::string(key), sizeof(T), {}});
+
+        auto &list = filter->receivers[filter_value(value)];
+        if (std::find(list.begin(), list.end(), d) != list.end())
+            return false;
+        list.emplace_back(std::move(d));
+
+        bool ok = false;
+        auto params = last(&ok);
+        size_t size = 0;
+        auto *current = params->get_direct(key, size);
+        if (ok && current && size == sizeof(T) &&
+            !memcmp(current, &value, sizeof(T)))
+            list.back()(*params, nullptr);
+        return true;
+    }
+
+    /**
+     * \brief Release the unused capacity of the receiver lists
+     * \defgroup signal++
+     */
+    void compact()
+    {
+        m_receivers.shrink_to_fit();
+        m_filters.shrink_to_fit();
+        for (auto &filter : m_filters) {
+            for (auto &bucket : filter.receivers)
+                bucket.second.shrink_to_fit();
+        }
+    }
+
+    /**
+     * \return the memory used by this signal and its receivers in bytes
+     * \defgroup signal++
+     */
+    size_t memory_usage() const
+    {
+        size_t n = sizeof(*this) + m_receivers.capacity() * sizeof(delegate);
+        for (const auto &recv : m_receivers)
+            n += recv.heap_size();
+        if (m_limiter) n += sizeof(limiter);
+        if (m_distinct) n += sizeof(distinct_state);
+        if (m_counters) n += sizeof(send_counters);
+        if (m_muted) n += sizeof(std::atomic<uint64_t>);
+        if (m_memo) {
+            std::lock_guard<std::mutex> lock(m_memo->lock);
+            n += sizeof(memo_cache);
+            n += m_memo->index.bucket_count() * sizeof(void *);
+            /* List nodes link both ways, hash nodes as for filters */
+            typedef std::pair<const uint64_t, void *> node;
+            for (const auto &e : m_memo->lru) {
+                n += sizeof(e) + 2 * sizeof(void *);
+                n += sizeof(node) + 2 * sizeof(void *);
+                n += e.input.memory_usage() - sizeof(parameters);
+                n += e.response.memory_usage() - sizeof(parameters);
+            }
+        }
+        n += m_routes.capacity() * sizeof(route);
+        for (const auto &r : m_routes)
+            n += r.target.capacity() + 1 + r.transform.heap_size();
+        n += m_plan.capacity() * sizeof(plan_step);
+        if (m_sticky) {
+            std::lock_guard<std::mutex> lock(m_sticky->lock);
+            n += sizeof(sticky_value);
+            if (m_sticky->last.use_count())
+                n += m_sticky->last->memory_usage();
+        }
+
+        /* Hash nodes hold the value, the cached hash and a next pointer */
+        typedef std::pair<const uint64_t, std::vector<delegate>> node;
+        n += m_filters.capacity() * sizeof(filter_index);
+        for (const auto &filter : m_filters) {
+            n += filter.key.capacity() + 1;
+            n += filter.receivers.bucket_count() * sizeof(void *);
+            for (const auto &list : filter.receivers) {
+                n += sizeof(node) + 2 * sizeof(void *);
+                n += list.second.capacity() * sizeof(delegate);
+                for (const auto &recv : list.second)
+                    n += recv.heap_size();
+            }
+        }
+        return n;
+    }
+};
+
+/**
+ * \brief State which is created on first use and stays with the object
+ * that created it, copies and moves of the owner start without it. Used
+ * for locks and threads which can't be copied. Creating the state is
+ * thread safe
+ * \defgroup signal++
+ */
+template <class T> class owned_state
+{
+    std::atomic<T *> m_state{nullptr};
+
+  public:
+    owned_state() = default;
+    owned_state(const owned_state &) {}
+    owned_state(owned_state &&) {}
+    ~owned_state() { reset(); }
+
+    owned_state &operator=(const owned_state &)
+    {
+        reset();
+        return *this;
+    }
+
+    owned_state &operator=(owned_state &&)
+    {
+        reset();
+        return *this;
+    }
+
+    /**
+     * \brief Destroy the state, the next get() creates a new one
+     * \defgroup signal++
+     */
+    void reset() { delete m_state.exchange(nullptr); }
+
+    T &get()
+    {
+        T *state = m_state.load(std::memory_order_acquire);
+        if (state) return *state;
+
+        T *created = new T;
+        if (m_state.compare_exchange_strong(state, created,
+                                            std::memory_order_acq_rel))
+            return *created;
+        delete created;
+        return *state;
+    }
+
+    explicit operator bool() const
+    {
+        return m_state.load(std::memory_order_acquire) != nullptr;
+    }
+
+    T *operator->() const { return m_state.load(std::memory_order_acquire); }
+};
+
+/**
+ * \brief Handle of a timer started by manager::send_after or send_every
+ * \defgroup signal++
+ */
+struct timer_handle {
+    uint32_t index = ~0u;
+    uint32_t generation = 0;
+
+    bool valid() const { return index != ~0u; }
+};
+
+/**
+ * \brief Hierarchical timing wheel of four levels with 256 slots each, a
+ * slot of level n spans 256^n ticks of one millisecond. Timers are nodes
+ * of intrusive lists, so starting and cancelling them is O(1) and a timer
+ * only costs one node of 48 bytes. Expired timers of the higher
+ * levels are moved down one level whenever the level below wraps around
+ * \class timer_wheel
+ * \defgroup signal++
+ */
+class timer_wheel
+{
+  public:
+    typedef std::chrono::steady_clock clock;
+    static constexpr std::chrono::milliseconds resolution{1};
+
+    /* The id stays valid for as long as the wheel exists */
+    struct expired {
+        const std::string *id;
+        shared_parameters params;
+    };
+
+  private:
+    static constexpr uint32_t slot_bits = 8, slot_count = 1 << slot_bits;
+    static constexpr uint32_t levels = 4, none = ~0u;
+
+    struct node {
+        uint64_t expires;
+        shared_parameters params;
+        uint32_t period, prev, next, list, generation, id;
+    };
+
+    std::vector<node> m_nodes;
+    uint32_t m_heads[levels * slot_count];
+    uint32_t m_free = none;
+    size_t m_count = 0;
+    uint64_t m_tick = 0;
+    clock::time_point m_start = clock::now();
+    std::deque<std::string> m_ids;
+    std::map<std::string, uint32_t, std::less<>> m_id_index;
+    mutable std::mutex m_lock;
+
+    uint64_t ticks(clock::time_point t) const
+    {
+        if (t <= m_start) return 0;
+        return uint64_t((t - m_start) / resolution);
+    }
+
+    static uint64_t ticks_ceil(clock::duration d)
+    {
+        if (d <= clock::duration::zero()) return 0;
+        return uint64_t((d + resolution - clock::duration(1)) / resolution);
+    }
+
+    uint32_t intern(std::string_view id)
+    {
+        auto it = m_id_index.find(id);
+        if (it != m_id_index.end()) return it->second;
+        m_ids.emplace_back(id);
+        m_id_index.emplace(m_ids.back(), uint32_t(m_ids.size() - 1));
+        return uint32_t(m_ids.size() - 1);
+    }
+
+    void link(uint32_t index)
+    {
+        auto &n = m_nodes[index];
+        if (n.expires < m_tick) n.expires = m_tick;
+        uint64_t delta = n.expires - m_tick, at = n.expires;
+        uint32_t level = 0;
+        while (level + 1 < levels && delta >> (slot_bits * (level + 1)))
+            level++;
+
+        /* Too far out for the wheel, wait in the last slot of the top
+         * level and get moved there again */
+        if (delta >> (slot_bits * levels))
+            at = m_tick + (uint64_t(1) << (slot_bits * levels)) - 1;
+
+        n.list = level * slot_count +
+                 uint32_t((at >> (slot_bits * level)) & (slot_count - 1));
+        n.prev = none;
+        n.next = m_heads[n.list];
+        if (n.next != none) m_nodes[n.next].prev = index;
+        m_heads[n.list] = index;
+    }
+
+    void unlink(uint32_t index)
+    {
+        auto &n = m_nodes[index];
+        if (n.prev != none)
+            m_nodes[n.prev].next = n.next;
+        else
+            m_heads[n.list] = n.next;
+        if (n.next != none) m_nodes[n.next].prev = n.prev;
+        n.list = none;
+    }
+
+    void release(uint32_t index)
+    {
+        auto &n = m_nodes[index];
+        n.params = shared_parameters();
+        n.generation++;
+        n.next = m_free;
+        m_free = index;
+        m_count--;
+    }
+
+    void cascade(uint32_t list)
+    {
+        uint32_t index = m_heads[list];
+        m_heads[list] = none;
+        while (index != none) {
+            uint32_t next = m_nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+  public:
+    timer_wheel()
+    {
+        for (auto &head : m_heads)
+            head = none;
+    }
+
+    /**
+     * \brief Start a timer
+     * \param id the signal to send
+     * \param delay the time until the first send, rounded up to the
+     * resolution
+     * \param period the time between sends, zero for a single send
+     * \param params the parameters of every send
+     * \return the handle to cancel the timer
+     * \defgroup signal++
+     */
+    timer_handle start(std::string_view id, clock::duration delay,
+                       clock::duration period, shared_parameters params)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        uint32_t index = m_free;
+        if (index == none) {
+            index = uint32_t(m_nodes.size());
+            m_nodes.push_back({});
+        } else {
+            m_free = m_nodes[index].next;
+        }
+
+        auto &n = m_nodes[index];
+        auto now = clock::now() - m_start;
+        n.expires = std::max(ticks_ceil(now + delay), m_tick + 1);
+        n.period = period > clock::duration::zero()
+                       ? uint32_t(std::min<uint64_t>(
+                             std::max<uint64_t>(ticks_ceil(period), 1),
+                             std::numeric_limits<uint32_t>::max()))
+                       : 0;
+        n.params = std::move(params);
+        n.id = intern(id);
+        link(index);
+        m_count++;
+        return {index, n.generation};
+    }
+
+    /**
+     * \brief Stop a timer
+     * \return true if the timer was still running
+     * \defgroup signal++
+     */
+    bool cancel(timer_handle t)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (t.index >= m_nodes.size()) return false;
+        auto &n = m_nodes[t.index];
+        if (n.generation != t.generation || n.list == none) return false;
+        unlink(t.index);
+        release(t.index);
+        return true;
+    }
+
+    /**
+     * \brief Move the wheel forward to now
+     * \param out the timers which expired are added to this list
+     * \defgroup signal++
+     */
+    void advance(clock::time_point now, std::vector<expired> &out)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        const uint64_t target = ticks(now);
+        while (m_count && m_tick < target) {
+            m_tick++;
+            for (uint32_t level = levels - 1; level > 0; level--) {
+                if (m_tick & ((uint64_t(1) << (slot_bits * level)) - 1))
+                    continue;
+                cascade(level * slot_count +
+                        uint32_t((m_tick >> (slot_bits * level)) &
+                                 (slot_count - 1)));
+            }
+
+            const uint32_t list = uint32_t(m_tick & (slot_count - 1));
+            while (m_heads[list] != none) {
+                uint32_t index = m_heads[list];
+                auto &n = m_nodes[index];
+                unlink(index);
+                out.push_back({&m_ids[n.id], n.params});
+                if (n.period) {
+                    n.expires = m_tick + n.period;
+                    link(index);
+                } else {
+                    release(index);
+                }
+            }
+        }
+        m_tick = std::max(m_tick, target);
+    }
+
+    /**
+     * \return the number of running timers
+     * \defgroup signal++
+     */
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_count;
+    }
+
+    /**
+     * \return the memory used by the wheel and its timers in bytes, shared
+     * parameters are not included
+     * \defgroup signal++
+     */
+    size_t memory_usage() const
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        size_t n = sizeof(*this) + m_nodes.capacity() * sizeof(node);
+        for (const auto &id : m_ids)
+            n += sizeof(id) + id.capacity() + 1;
+        return n + m_id_index.size() * (sizeof(decltype(
+                                            m_id_index)::value_type) +
+                                        4 * sizeof(void *));
+    }
+};
+
+/**
+ * \brief The manager class, manages signals
+ * \class manager
+ * \defgroup signal++
+ */
+class manager
+{
+    typedef std::map<std::string, signal, std::less<>> signal_map;
+    signal_map m_signals;
+
+    /* Table built by freeze(), the signals are moved out of m_signals and
+     * stored in the slot given by a minimal perfect hash of their id. The
+     * ids are packed into m_frozen_keys */
+    struct frozen_slot {
+        uint64_t hash;
+        uint32_t key, key_len;
+        signal sig;
+    };
+    std::vector<frozen_slot> m_frozen;
+    std::vector<uint32_t> m_seeds;
+    std::string m_frozen_keys;
+    uint64_t m_salt = 0;
+    bool m_counting = false;
+
+    /* Groups muted by mute(), copies take the current value */
+    struct group_mask {
+        std::atomic<uint64_t> bits{0};
+
+        group_mask() = default;
+        group_mask(const group_mask &o) : bits(o.bits.load()) {}
+        group_mask &operator=(const group_mask &o)
+        {
+            bits.store(o.bits.load());
+            return *this;
+        }
+    };
+    group_mask m_muted;
+
+    /* Timers and the thread driving them, see send_after() */
+    struct timer_state {
+        timer_wheel wheel;
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable wake;
+        bool running = false;
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                running = false;
+            }
+            wake.notify_all();
+            if (thread.joinable()) thread.join();
+        }
+
+        ~timer_state() { stop(); }
+    };
+    owned_state<timer_state> m_timers;
+
+    /* Sends queued by post(), the eventfd is readable while any queue
+     * isn't empty */
+    struct post_queue {
+        struct item {
+            std::string id;
+            shared_parameters params;
+            post_options::clock::time_point deadline;
+            uint64_t seq;
+            post_class priority;
+        };
+
+        /* Heap of the sends of one class, the earliest deadline is on top
+         * and sends with the same deadline keep their order */
+        struct class_queue {
+            std::vector<item> heap;
+            size_t limit = std::numeric_limits<size_t>::max();
+            uint64_t expired = 0, rejected = 0;
+        };
+
+        static bool later(const item &a, const item &b)
+        {
+            if (a.deadline != b.deadline) return a.deadline > b.deadline;
+            return a.seq > b.seq;
+        }
+
+        std::mutex lock;
+        std::condition_variable space;
+        class_queue classes[post_classes];
+        size_t count = 0;
+        uint64_t seq = 0;
+        std::vector<item> batch;
+        int fd = -1;
+
+        post_queue()
+        {
+#ifdef LINUX
+            fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+        }
+
+        ~post_queue()
+        {
+#ifdef LINUX
+            if (fd >= 0) close(fd);
+#endif
+        }
+
+        void wake()
+        {
+#ifdef LINUX
+            uint64_t one = 1;
+            ssize_t r = write(fd, &one, sizeof(one));
+            (void)r;
+#endif
+        }
+
+        void clear()
+        {
+#ifdef LINUX
+            uint64_t count;
+            ssize_t r = read(fd, &count, sizeof(count));
+            (void)r;
+#endif
+        }
+    };
+    owned_state<post_queue> m_posts;
+
+    static uint64_t frozen_hash(std::string_view id, uint64_t salt)
+    {
+        uint64_t h = 14695981039346656037ull ^ (salt * 0x9e3779b97f4a7c15ull);
+        for (char c : id) {
+            h ^= uint8_t(c);
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    static size_t frozen_index(uint64_t hash, uint32_t seed, size_t count)
+    {
+        hash += (uint64_t(seed) + 1) * 0x9e3779b97f4a7c15ull;
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+        return size_t((hash ^ (hash >> 31)) % count);
+    }
+
+    /* Hash and displace: the ids are split into buckets of about four ids,
+     * then starting with the largest bucket a seed is searched which moves
+     * all ids of the bucket into free slots. Fails if no seed is found,
+     * the caller then retries with another salt */
+    static bool build_seeds(const std::vector<uint64_t> &hashes,
+                            std::vector<uint32_t> &seeds,
+                            std::vector<uint32_t> &slots)
+    {
+        const size_t count = hashes.size();
+        std::vector<std::vector<uint32_t>> buckets(seeds.size());
+        for (size_t i = 0; i < count; i++)
+            buckets[hashes[i] % seeds.size()].push_back(uint32_t(i));
+
+        std::vector<uint32_t> order(buckets.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = uint32_t(i);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return buckets[a].size() > buckets[b].size();
+                         });
+
+        std::vector<bool> taken(count);
+        std::vector<size_t> pos;
+        const uint32_t max_seed = uint32_t(std::min<size_t>(
+            std::numeric_limits<uint32_t>::max(), count * 16 + 1024));
+        for (uint32_t b : order) {
+            const auto &bucket = buckets[b];
+            if (bucket.empty()) break;
+
+            uint32_t seed = 0;
+            for (; seed < max_seed; seed++) {
+                pos.clear();
+                for (uint32_t i : bucket) {
+                    size_t slot = frozen_index(hashes[i], seed, count);
+                    if (taken[slot] || std::find(pos.begin(), pos.end(),
+                                                 slot) != pos.end())
+                        break;
+                    pos.push_back(slot);
+                }
+                if (pos.size() == bucket.size()) break;
+            }
+            if (seed == max_seed) return false;
+
+            seeds[b] = seed;
+            for (size_t i = 0; i < bucket.size(); i++) {
+                taken[pos[i]] = true;
+                slots[bucket[i]] = uint32_t(pos[i]);
+            }
+        }
+        return true;
+    }
+
+    const signal *find(std::string_view id) const
+    {
+        if (m_frozen.empty()) {
+            auto sig = m_signals.find(id);
+            return sig == m_signals.end() ? nullptr : &sig->second;
+        }
+        uint64_t h = frozen_hash(id, m_salt);
+        const auto &slot = m_frozen[frozen_index(
+            h, m_seeds[h % m_seeds.size()], m_frozen.size())];
+        if (slot.hash != h || slot.key_len != id.size() ||
+            memcmp(m_frozen_keys.data() + slot.key, id.data(), id.size()))
+            return nullptr;
+        return &slot.sig;
+    }
+
+    signal *find(std::string_view id)
+    {
+        return const_cast<signal *>(std::as_const(*this).find(id));
+    }
+
+    template <class F> void for_each_signal(const F &f)
+    {
+        for (auto &sig : m_signals)
+            f(sig.second);
+        for (auto &slot : m_frozen)
+            f(slot.sig);
+    }
+
+    /* The plans point to the signals, so they are rebuilt whenever a route
+     * is added or the signals move */
+    void compile_routes()
+    {
+        auto lookup = [this](std::string_view id) { return find(id); };
+        for_each_signal([&](signal &sig) {
+            if (!sig.has_routes()) return;
+            std::vector<signal::plan_step> plan;
+            uint32_t slots = 0;
+            sig.flatten_routes(lookup, 0, plan, slots);
+            sig.set_plan(std::move(plan), slots);
+        });
+    }
+
+    signal &emplace(std::string_view id, delegate d = delegate())
+    {
+        const bool was_frozen = frozen();
+        if (was_frozen) thaw();
+
+        auto sig = m_signals.emplace(id, signal(std::move(d))).first;
+#ifdef LIBSIGNAL_TRACE
+        sig->second.set_trace_name(id);
+#endif
+        sig->second.set_counters(m_counting);
+        if (!was_frozen) return sig->second;
+        freeze();
+        return *find(id);
+    }
+
+  public:
+    manager() = default;
+    ~manager() = default;
+
+    /**
+     * \brief Copies the signals, their receivers and routes. Timers are not
+     * copied
+     * \defgroup signal++
+     */
+    manager(const manager &o)
+        : m_signals(o.m_signals), m_frozen(o.m_frozen), m_seeds(o.m_seeds),
+          m_frozen_keys(o.m_frozen_keys), m_salt(o.m_salt),
+          m_counting(o.m_counting), m_muted(o.m_muted)
+    {
+        compile_routes();
+    }
+
+    /**
+     * \brief Moves the signals, their receivers and routes. Timers and
+     * posted sends of both managers are dropped before the signals move,
+     * their thread would otherwise still send on them
+     * \defgroup signal++
+     */
+    manager(manager &&o) { *this = std::move(o); }
+
+    manager &operator=(const manager &o)
+    {
+        if (this != &o) *this = manager(o);
+        return *this;
+    }
+
+    manager &operator=(manager &&o)
+    {
+        if (this == &o) return *this;
+        m_timers.reset();
+        m_posts.reset();
+        o.m_timers.reset();
+        o.m_posts.reset();
+
+        m_signals = std::move(o.m_signals);
+        m_frozen = std::move(o.m_frozen);
+        m_seeds = std::move(o.m_seeds);
+        m_frozen_keys = std::move(o.m_frozen_keys);
+        m_salt = o.m_salt;
+        m_counting = o.m_counting;
+        m_muted = o.m_muted;
+        return *this;
+    }
+
+    /**
+     * \brief Send a signal to all receivers
+     * \param id the id of the signal to invoke
+     * \param param the parameters to send to the receivers
+     * \param response the response parameters used by the receivers (shared by
+     * all receivers) \return true if the signal could be found, otherwise
+     * false. Sends dropped by the send policy of the signal return true
+     * \defgroup signal++
+     */
+    bool send(std::string_view id, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+#ifdef LIBSIGNAL_ALLOC_STATS
+        alloc_scope scope(alloc_stats::thread().send_allocations);
+#endif
+        auto *sig = find(id);
+        if (!sig) return false;
+        const uint64_t muted = m_muted.bits.load(std::memory_order_relaxed);
+        if (muted && sig->muted(muted)) return true;
+        if (!sig->admit()) return true;
+
+        /* A memoized send always gets a response, so the cache replaces
+         * the distinct check which would leave it empty. Hits count as
+         * sends */
+        uint64_t fingerprint = 0;
+        const bool memo = response && sig->memoized();
+        if (!memo && !sig->changed(param)) return true;
+        const uint64_t start = sig->count_send();
+        if (memo && sig->recall(param, *response, fingerprint)) {
+            if (start) sig->count_latency(start);
+            return true;
+        }
+
+        const size_t before = memo ? response->size() : 0;
+        {
+#ifdef LIBSIGNAL_TRACE
+            trace::scope span(sig->trace_name(), trace::kind::send);
+#endif
+            sig->invoke(param, response);
+            sig->run_plan(param, response, muted);
+        }
+        if (start) sig->count_latency(start);
+        if (memo) sig->remember(fingerprint, param, *response, before);
+        return true;
+    }
+
+    /**
+     * \brief Limit the sends of a signal, e.g. set_policy("mouse.move",
+     * send_policy::limit(1000)). Sends beyond the limit are dropped before
+     * any receiver runs and counted in stats(id).dropped. This must not be
+     * called while the signal is sent from another thread
+     * \param id the id of the signal
+     * \param policy the policy, a default policy removes the limit
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool set_policy(std::string_view id, const send_policy &policy)
+    {
+        auto *sig = find(id);
+        if (!sig) return false;
+        sig->set_policy(policy);
+        return true;
+    }
+
+    /**
+     * \brief Make a signal sticky, e.g. for state like the current scene.
+     * The manager keeps the parameters of the last send and passes them
+     * to every receiver added later, so they don't have to wait for the
+     * next send. Every send then locks a mutex and copies its parameters
+     * into a list whose memory is reused, so this suits state which
+     * changes rarely more than signals sent at a high rate. This must not
+     * be called while the signal is sent from another thread
+     * \param id the id of the signal
+     * \param sticky false removes the stored parameters
+     * \param evaluate run the generators of lazy values of every send so
+     * they can be replayed. If false they stay lazy and values which no
+     * receiver read are not stored
+     * \return true if the signal exists and isn't memoized, see
+     * set_memoize()
+     * \defgroup signal++
+     */
+    bool set_sticky(std::string_view id, bool sticky = true,
+                    bool evaluate = true)
+    {
+        auto *sig = find(id);
+        if (!sig || (sticky && sig->memoized())) return false;
+        sig->set_sticky(sticky, evaluate);
+        return true;
+    }
+
+    /**
+     * \brief Skip sends of a signal whose parameters did not change since
+     * the previous send, e.g. for a value polled every frame. Parameters
+     * are compared by their fingerprint(), skipped sends are counted in
+     * stats(id).suppressed. Sends of a memoized signal which collect a
+     * response are answered by the cache instead, see set_memoize(). This
+     * must not be called while the signal is sent from another thread
+     * \param id the id of the signal
+     * \param distinct false sends every time again
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool set_distinct(std::string_view id, bool distinct = true)
+    {
+        auto *sig = find(id);
+        if (!sig) return false;
+        sig->set_distinct(distinct);
+        return true;
+    }
+
+    /**
+     * \brief Put a signal into groups which can be muted together, e.g. all
+     * overlay signals. This must not be called while the signal is sent
+     * from another thread
+     * \param id the id of the signal
+     * \param groups one bit per group, zero removes the signal from all
+     * groups
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool set_groups(std::string_view id, uint64_t groups)
+    {
+        auto *sig = find(id);
+        if (!sig) return false;
+        sig->set_groups(groups);
+        return true;
+    }
+
+    /**
+     * \brief Skip all sends of signals in the given groups until they are
+     * unmuted. Skipped sends return true and are counted in
+     * stats(id).muted. While nothing is muted a send only loads the mask
+     * once. This can be called from any thread
+     * \param groups one bit per group
+     * \defgroup signal++
+     */
+    void mute(uint64_t groups)
+    {
+        m_muted.bits.fetch_or(groups, std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Send the signals of the given groups again, see mute()
+     * \param groups one bit per group
+     * \defgroup signal++
+     */
+    void unmute(uint64_t groups)
+    {
+        m_muted.bits.fetch_and(~groups, std::memory_order_relaxed);
+    }
+
+    /**
+     * \return the muted groups, one bit per group
+     * \defgroup signal++
+     */
+    uint64_t muted() const
+    {
+        return m_muted.bits.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Cache the responses of a signal whose receivers only compute
+     * the response from the parameters, e.g. looking up a key name. A send
+     * with the same parameters as a cached one adds the values the
+     * receivers added before to its response and skips the receivers. Only
+     * sends with a response are cached, parameters are compared by their
+     * fingerprint() and then by value. Hits count as sends and are counted
+     * in stats(id).cache_hits. The cache is dropped when receivers are
+     * added or removed. A hit would skip routes and the stored value of a
+     * sticky signal, so signals with either can't be memoized and memoized
+     * ones can't get them. This must not be called while the signal is
+     * sent from another thread
+     * \param id the id of the signal
+     * \param capacity the most responses which are kept, the least
+     * recently used one is replaced. Zero removes the cache
+     * \return true if the signal exists and has no routes and isn't sticky
+     * \defgroup signal++
+     */
+    bool set_memoize(std::string_view id, size_t capacity = 256)
+    {
+        auto *sig = find(id);
+        if (!sig || (capacity && (sig->has_routes() || sig->sticky())))
+            return false;
+        sig->set_memoize(capacity);
+        return true;
+    }
+
+    /**
+     * \brief Remove the cached responses of a memoized signal, e.g. after
+     * the data its receivers look up changed
+     * \param id the id of the signal
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool invalidate(std::string_view id) const
+    {
+        auto *sig = find(id);
+        if (!sig) return false;
+        sig->invalidate();
+        return true;
+    }
+
+    /**
+     * \brief Get the parameters of the last send of a sticky signal
+     * \param id the id of the signal
+     * \param ok will be set to true if the signal is sticky and was sent
+     * at least once (optional)
+     * \return the parameters, empty if there are none
+     * \defgroup signal++
+     */
+    shared_parameters last(std::string_view id, bool *ok = nullptr) const
+    {
+        auto *sig = find(id);
+        if (ok) *ok = false;
+        return sig ? sig->last(ok) : shared_parameters();
+    }
+
+    /**
+     * \param id the id of the signal
+     * \param ok will be set to true if the signal exists (optional)
+     * \return the counters of a signal
+     * \defgroup signal++
+     */
+    signal_stats stats(std::string_view id, bool *ok = nullptr) const
+    {
+        auto *sig = find(id);
+        if (ok) *ok = sig != nullptr;
+        if (!sig) return signal_stats();
+        return sig->stats();
+    }
+
+    /**
+     * \brief Call f(id, stats) for every signal, see stats()
+     * \defgroup signal++
+     */
+    template <class F> void for_each_stats(const F &f) const
+    {
+        for (const auto &sig : m_signals)
+            f(std::string_view(sig.first), sig.second.stats());
+        for (const auto &slot : m_frozen)
+            f(std::string_view(m_frozen_keys).substr(slot.key, slot.key_len),
+              slot.sig.stats());
+    }
+
+    /**
+     * \brief Count the sends, sends without receivers and the duration of
+     * every 16th send of all signals, e.g. to publish them with
+     * shm_stats.h. A send then costs one more atomic increment. This must
+     * not be called while signals are sent from other threads
+     * \param enabled false removes the counters
+     * \defgroup signal++
+     */
+    void set_counters(bool enabled = true)
+    {
+        m_counting = enabled;
+        for_each_signal(
+            [enabled](signal &sig) { sig.set_counters(enabled); });
+    }
+
+    /**
+     * \brief Check if sending a signal would reach any receiver, so building
+     * expensive parameters can be skipped
+     * \param id the id of the signal
+     * \return true if the signal exists and has at least one receiver
+     * \defgroup signal++
+     */
+    bool has_receivers(std::string_view id) const
+    {
+        auto *sig = find(id);
+        return sig && sig->has_receivers();
+    }
+
+    /**
+     * \brief Add a signal to the manager
+     * \param id the id of the signal to register
+     * \param d the first receiver for this signal, this can be a function,
+     * a lambda or a receiver object (optional)
+     * \return true if the signal could be added, false if the id already
+     * exists and d is empty or already registered
+     * \defgroup signal++
+     */
+    bool add(std::string_view id, delegate d = delegate())
+    {
+#ifdef LIBSIGNAL_ALLOC_STATS
+        alloc_scope scope(alloc_stats::thread().add_allocations);
+#endif
+        auto *sig = find(id);
+        if (!sig) {
+            emplace(id, std::move(d));
+            return true;
+        }
+        if (!sig->add_receiver(std::move(d))) return false;
+        sig->invalidate();
+        return true;
+    }
+
+    /**
+     * \brief Remove a receiver of a signal, the signal stays registered
+     * \param id the id of the signal
+     * \param d a receiver equal to the one to remove, see
+     * signal::remove_receiver()
+     * \return true if the receiver was found
+     * \defgroup signal++
+     */
+    bool remove(std::string_view id, const delegate &d)
+    {
+        auto *sig = find(id);
+        if (!sig || !sig->remove_receiver(d)) return false;
+        sig->invalidate();
+        return true;
+    }
+
+    /**
+     * \brief Add a member function of an object as a receiver, the object has
+     * to outlive the manager
+     * \param id the id of the signal to register
+     * \param obj the object
+     * \param method the member function to call
+     * \return see add(id, d)
+     * \defgroup signal++
+     */
+    template <class T>
+    bool add(std::string_view id, T *obj,
+             void (T::*method)(const parameters &, parameters *))
+    {
+        return add(id, delegate(obj, method));
+    }
+
+    /**
+     * \brief Add a receiver which is only called if the parameter key has
+     * the given value, e.g. add_filtered("input.key", "key", 42, f). Sends
+     * look up the value once and only call the matching receivers, instead
+     * of calling every receiver which then checks the value itself
+     * \param id the id of the signal, it is registered if it doesn't exist
+     * \param key the id of the parameter to check
+     * \param value the value the parameter needs to have, its type has to
+     * match the type of the parameter
+     * \param d the receiver
+     * \return true if the receiver could be added, false if it is empty or
+     * already registered for this value \defgroup signal++
+     */
+    template <class T>
+    bool add_filtered(std::string_view id, std::string_view key,
+                      const T &value, delegate d)
+    {
+        auto *sig = find(id);
+        if (!sig) sig = &emplace(id);
+        if (!sig->add_filtered(key, value, std::move(d))) return false;
+        sig->invalidate();
+        return true;
+    }
+
+    /**
+     * \brief Send a signal whenever another one is sent, e.g.
+     * connect("raw.input", "input.key", decode) instead of a receiver on
+     * raw.input which sends input.key. The connections of a signal are
+     * flattened into one list of sends, so a send runs through a chain of
+     * signals without looking them up or copying the parameters again.
+     * Connections which would form a cycle are rejected
+     * \param src the id of the signal which is sent first, it is
+     * registered if it doesn't exist
+     * \param dst the id of the signal sent afterwards, it is registered if
+     * it doesn't exist
+     * \param transform gets the parameters of src and fills its response
+     * parameters with the parameters of dst. If it is empty dst gets the
+     * parameters of src
+     * \return false if the connection exists, would form a cycle or src
+     * is memoized, see set_memoize()
+     * \defgroup signal++
+     */
+    bool connect(std::string_view src, std::string_view dst,
+                 delegate transform = delegate())
+    {
+        auto lookup = [this](std::string_view id) { return find(id); };
+        const signal *from = find(src), *to = find(dst);
+        if (src == dst || (from && from->memoized()) ||
+            (from && to && to->routes_to(lookup, from)))
+            return false;
+
+        if (!to) emplace(dst);
+        auto *sig = find(src);
+        if (!sig) sig = &emplace(src);
+        if (!sig->add_route(dst, std::move(transform))) return false;
+        compile_routes();
+        return true;
+    }
+
+    /**
+     * \brief Queue a send which is run by process_ready(), e.g. to pass
+     * work from other threads to an event loop. This can be called from
+     * any thread
+     * \param id the id of the signal
+     * \param params the parameters of the send
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool post(std::string_view id,
+              shared_parameters params = shared_parameters())
+    {
+        return post(id, std::move(params), post_options());
+    }
+
+    /**
+     * \brief Queue a send with a priority class and a deadline. Each class
+     * has its own queue, process_ready() drains them in the order of the
+     * classes and each queue by the earliest deadline first. Sends which
+     * missed their deadline are dropped and counted as expired. If the
+     * queue of the class is full, post waits up to options.wait for room,
+     * so a burst of bulk sends slows down its producers instead of
+     * delaying critical sends. Don't wait on the thread which calls
+     * process_ready(). This can be called from any thread
+     * \param id the id of the signal
+     * \param params the parameters of the send
+     * \param options the class, deadline and wait time
+     * \return true if the send was queued, false if the signal doesn't
+     * exist or the queue stayed full
+     * \defgroup signal++
+     */
+    bool post(std::string_view id, shared_parameters params,
+              const post_options &options)
+    {
+        if (!find(id)) return false;
+        auto &q = m_posts.get();
+        auto &c = q.classes[size_t(options.priority)];
+        bool was_empty;
+        {
+            std::unique_lock<std::mutex> lock(q.lock);
+            if (c.heap.size() >= c.limit &&
+                (options.wait.count() <= 0 ||
+                 !q.space.wait_for(lock, options.wait, [&c] {
+                     return c.heap.size() < c.limit;
+                 }))) {
+                c.rejected++;
+                return false;
+            }
+            was_empty = q.count++ == 0;
+            c.heap.push_back({std::string(id), std::move(params),
+                              options.deadline, q.seq++, options.priority});
+            std::push_heap(c.heap.begin(), c.heap.end(), post_queue::later);
+        }
+
+        /* Only the first post of a burst wakes up the event loop */
+        if (was_empty) q.wake();
+        return true;
+    }
+
+    /**
+     * \brief Limit the number of queued sends of a priority class, see
+     * post(). The queues are unbounded by default
+     * \param priority the class
+     * \param limit the most sends the queue holds
+     * \defgroup signal++
+     */
+    void set_post_limit(post_class priority, size_t limit)
     {
-        auto tmp = m_parameters.find(id);
-        if (tmp == m_parameters.end()) {
-            void *d = malloc(s);
-            memcpy(d, data, s);
-            m_parameters[id].second = d;
-            m_parameters[id].first = s;
-            return true;
+        auto &q = m_posts.get();
+        {
+            std::lock_guard<std::mutex> lock(q.lock);
+            q.classes[size_t(priority)].limit = limit;
         }
-        return false;
+        q.space.notify_all();
     }
 
     /**
-     * \brief Get a variable from the list
-     * \param id the id of the parameter
-     * \param ok will be set to true on success (optional)
-     * \param def the default return value on failure (optional)
-     * \return the value of the parameter
+     * \return the counters of the queue of a priority class
      * \defgroup signal++
      */
-    template <class T>
-    const T &get(const std::string &id, bool *ok = nullptr,
-                 const T &def = T()) const
+    post_queue_stats post_stats(post_class priority)
     {
-        auto p = m_parameters.find(id);
-        if (p == m_parameters.end()) {
-            if (ok) *ok = false;
-            return def;
-        }
-        if (sizeof(T) != p->second.first) {
-            if (ok) *ok = false;
-            return def;
-        }
-        if (ok) *ok = true;
-        return *reinterpret_cast<T *>(p->second.second);
+        auto &q = m_posts.get();
+        std::lock_guard<std::mutex> lock(q.lock);
+        const auto &c = q.classes[size_t(priority)];
+        post_queue_stats s;
+        s.queued = c.heap.size();
+        s.limit = c.limit;
+        s.expired = c.expired;
+        s.rejected = c.rejected;
+        return s;
     }
 
     /**
-     * \brief Get a data pointer from the list
-     * \param id the id of the parameter
-     * \param ok will be set to true on success (optional)
-     * \param def the default return value on failure (optional)
-     * \return the value of the parameter, this is a direct pointer and should
-     * be copied \defgroup signal++
+     * \brief Get a file descriptor which is readable while posted sends are
+     * queued, add it to a poll/epoll loop and call process_ready() when
+     * it is readable. If the loop uses edge triggered epoll, process_ready()
+     * has to be called again while post_stats() shows queued sends
+     * \return the file descriptor, -1 if the platform has no eventfd
+     * \defgroup signal++
      */
-    void *get_direct(const std::string &id, bool *ok = nullptr,
-                     void *def = nullptr) const
-    {
-        auto p = m_parameters.find(id);
-        if (p == m_parameters.end()) {
-            if (ok) *ok = false;
-            return def;
-        }
-        if (ok) *ok = true;
-        return p->second.second;
-    }
-};
+    int fd() { return m_posts.get().fd; }
 
-/**
- * \brief The receiver class is an interface class, which can be implemented
- * to allow sending of signals to objects
- * \class receiver
- * \defgroup signal++
- */
-class receiver
-{
-  public:
-    virtual ~receiver() = default;
-    virtual void receive(const parameters &param = parameters(),
-                         parameters *out = nullptr) = 0;
-};
+    /**
+     * \brief Run the sends queued by post() on this thread, higher classes
+     * first and each class by the earliest deadline. A small max_items
+     * lets critical sends posted meanwhile overtake the rest sooner
+     * \param max_items the maximum number of sends to run
+     * \return the number of sends which were run, sends which expired
+     * before their turn are not counted
+     * \defgroup signal++
+     */
+    size_t process_ready(
+        size_t max_items = std::numeric_limits<size_t>::max())
+    {
+        if (!m_posts) return 0;
+        auto &q = m_posts.get();
+        const auto now = post_options::clock::now();
+        constexpr auto none = post_options::clock::time_point::max();
 
-/**
- * \typedef Function pointer
- * \brief Structure for any method called by a signal
- * \param params    Parameters sent to this method by the signal caller
- * \param repsonse    Output data for this signal (shared by all methods)
- * \defgroup signal++
- */
-typedef void (*signal_function)(const parameters &param, parameters *response);
+        /* Take the batch list so nested calls from receivers use their own */
+        std::vector<post_queue::item> batch;
+        {
+            std::lock_guard<std::mutex> lock(q.lock);
+            batch.swap(q.batch);
+            for (auto &c : q.classes) {
+                while (batch.size() < max_items && !c.heap.empty()) {
+                    std::pop_heap(c.heap.begin(), c.heap.end(),
+                                  post_queue::later);
+                    q.count--;
+                    if (c.heap.back().deadline < now)
+                        c.expired++;
+                    else
+                        batch.push_back(std::move(c.heap.back()));
+                    c.heap.pop_back();
+                }
+            }
+            if (!q.count) q.clear();
+        }
+        q.space.notify_all();
 
-/**
- * \brief The signal class holds all receivers for this signal
- * they are separated in receiver methods and receiver objects
- * \class signal
- * \defgroup signal++
- */
-class signal
-{
-    std::vector<signal_function> m_receivers;
-    std::vector<std::shared_ptr<receiver>> m_receiver_objects;
+        size_t n = 0;
+        for (const auto &item : batch) {
+            /* Earlier sends of the batch may have run past the deadline */
+            if (item.deadline != none &&
+                item.deadline < post_options::clock::now()) {
+                std::lock_guard<std::mutex> lock(q.lock);
+                q.classes[size_t(item.priority)].expired++;
+                continue;
+            }
+            send(item.id, *item.params);
+            n++;
+        }
 
-  public:
-    signal() = default;
+        batch.clear();
+        std::lock_guard<std::mutex> lock(q.lock);
+        if (batch.capacity() > q.batch.capacity()) q.batch.swap(batch);
+        return n;
+    }
 
     /**
-     * \brief Adds f as the first receiver
-     * \param f the first receiver for this signal
+     * \brief Send a signal once after a delay. Timers are run by
+     * advance_timers() or the thread started by start_timers(). They belong
+     * to this manager object and are not copied or moved with it
+     * \param id the id of the signal
+     * \param delay the time until the send, rounded up to milliseconds
+     * \param params the parameters of the send
+     * \return the handle to cancel the timer, it is not valid if the signal
+     * doesn't exist
      * \defgroup signal++
      */
-    signal(signal_function f) { m_receivers.emplace_back(f); }
+    timer_handle send_after(std::string_view id,
+                            timer_wheel::clock::duration delay,
+                            shared_parameters params = shared_parameters())
+    {
+        if (!find(id)) return timer_handle();
+        return m_timers.get().wheel.start(id, delay,
+                                          timer_wheel::clock::duration(),
+                                          std::move(params));
+    }
 
     /**
-     * \brief Adds r as the first receiver object
-     * \param r the first receiver object for this signal
+     * \brief Send a signal periodically, e.g. for polling or autosaves
+     * \param id the id of the signal
+     * \param period the time between sends, rounded up to milliseconds.
+     * Sends missed because timers weren't advanced in time are skipped
+     * \param params the parameters of every send
+     * \return see send_after()
      * \defgroup signal++
      */
-    signal(receiver *r)
+    timer_handle send_every(std::string_view id,
+                            timer_wheel::clock::duration period,
+                            shared_parameters params = shared_parameters())
     {
-        if (r) m_receiver_objects.emplace_back(std::shared_ptr<receiver>(r));
+        if (!find(id)) return timer_handle();
+        return m_timers.get().wheel.start(id, period, period,
+                                          std::move(params));
     }
 
     /**
-     * \brief Adds r as the first receiver object using a shared pointer
-     * to ensure that the object exists as long as this signal does
-     * \param r the first receiver object for this signal
+     * \brief Stop a timer started by send_after() or send_every()
+     * \return true if the timer was still running
      * \defgroup signal++
      */
-    signal(std::shared_ptr<receiver> &&r)
+    bool cancel(timer_handle t)
     {
-        m_receiver_objects.emplace_back(r);
+        return m_timers && m_timers->wheel.cancel(t);
     }
 
     /**
-     * \brief Invoke this signal
-     * \param param the paramters to send to the receivers (optional)
-     * \param response the response used by the receivers (shared by all
-     * receivers) (optional) \defgroup signal++
+     * \brief Send the signals of all timers which expired until now, call
+     * this from your main loop if the timer thread isn't used
+     * \param now the current time
+     * \return the number of sends
+     * \defgroup signal++
      */
-    void invoke(const parameters &param = parameters(),
-                parameters *response = nullptr) const
+    size_t advance_timers(
+        timer_wheel::clock::time_point now = timer_wheel::clock::now())
     {
-        for (const auto &recv : m_receivers)
-            recv(param, response);
-        for (const auto &recv_obj : m_receiver_objects)
-            recv_obj->receive(param, response);
+        if (!m_timers) return 0;
+        std::vector<timer_wheel::expired> expired;
+        m_timers->wheel.advance(now, expired);
+        for (const auto &e : expired)
+            send(*e.id, *e.params);
+        return expired.size();
     }
 
     /**
-     * \brief Add a receiver for this signal
-     * \param f the receiver function
-     * \return true if the function could be added, false if it is already
-     * registered \defgroup signal++
+     * \brief Start a thread which calls advance_timers(). Its sends run
+     * concurrently to the sends of other threads, so receivers must not
+     * be added while it runs
+     * \param interval the time between two calls
+     * \defgroup signal++
      */
-    bool add_receiver(signal_function f)
+    void start_timers(std::chrono::nanoseconds interval =
+                          std::chrono::milliseconds(1))
     {
-        if (!f) return false;
-        if (std::find(m_receivers.begin(), m_receivers.end(), f) ==
-            m_receivers.end()) {
-            m_receivers.emplace_back(f);
-            return true;
-        }
-        return false;
+        stop_timers();
+        auto &t = m_timers.get();
+        t.running = true;
+        t.thread = std::thread([this, &t, interval] {
+            std::unique_lock<std::mutex> lock(t.lock);
+            while (t.running) {
+                lock.unlock();
+                advance_timers();
+                lock.lock();
+                t.wake.wait_for(lock, interval, [&t] { return !t.running; });
+            }
+        });
     }
 
     /**
-     * \brief Add a receiver object for this signal using a shared pointer
-     * to ensure that the object exists for as long as this signal does
-     * \param r the receiver object
-     * \return true if the receiver object could be added, false if it is
-     * already registered \defgroup signal++
+     * \brief Stop the thread started by start_timers(), the timers keep
+     * running and can be advanced manually
+     * \defgroup signal++
      */
-    bool add_receiver_obj(std::shared_ptr<receiver> &&r)
+    void stop_timers()
     {
-        if (!r) return false;
-        if (std::find(m_receiver_objects.begin(), m_receiver_objects.end(),
-                      r) == m_receiver_objects.end()) {
-            m_receiver_objects.emplace_back(r);
-            return true;
-        }
-        return false;
+        if (m_timers) m_timers->stop();
     }
-};
-
-/**
- * \brief The manager class, manages signals
- * \class manager
- * \defgroup signal++
- */
-class manager
-{
-    std::map<std::string, signal> m_signals;
-
-  public:
-    manager() = default;
-    ~manager() = default;
 
     /**
-     * \brief Send a signal to all receivers
-     * \param id the id of the signal to invoke
-     * \param param the parameters to send to the receivers
-     * \param response the response parameters used by the receivers (shared by
-     * all receivers) \return true if the signal could be found, otherwise false
+     * \brief Replace the signal table with a flat table indexed by a minimal
+     * perfect hash of the ids, e.g. once all signals are registered at
+     * startup. Lookups then take one hash and a single probe instead of a
+     * tree walk, and the per signal tree nodes and id allocations are
+     * dropped. Receivers can still be added to existing signals, adding a
+     * new signal rebuilds the table
      * \defgroup signal++
      */
-    bool send(const std::string &id, const parameters &param = parameters(),
-              parameters *response = nullptr) const
+    void freeze()
     {
-        auto sig = m_signals.find(id);
-        if (sig == m_signals.end()) return false;
-        sig->second.invoke(param, response);
-        return true;
+        if (frozen()) thaw();
+        if (m_signals.empty()) return;
+
+        std::vector<signal_map::iterator> sigs;
+        std::vector<uint64_t> hashes;
+        std::vector<uint32_t> slots(m_signals.size());
+        std::vector<uint32_t> seeds((m_signals.size() + 3) / 4);
+        size_t key_size = 0;
+        sigs.reserve(m_signals.size());
+        for (auto it = m_signals.begin(); it != m_signals.end(); ++it) {
+            sigs.push_back(it);
+            key_size += it->first.size();
+        }
+
+        uint64_t salt = 0;
+        for (;; salt++) {
+            hashes.clear();
+            for (auto it : sigs)
+                hashes.push_back(frozen_hash(it->first, salt));
+            if (build_seeds(hashes, seeds, slots)) break;
+        }
+
+        std::vector<uint32_t> by_slot(sigs.size());
+        for (size_t i = 0; i < sigs.size(); i++)
+            by_slot[slots[i]] = uint32_t(i);
+
+        m_frozen.reserve(sigs.size());
+        m_frozen_keys.reserve(key_size);
+        for (uint32_t i : by_slot) {
+            auto &sig = sigs[i]->second;
+            sig.compact();
+            m_frozen.push_back({hashes[i], uint32_t(m_frozen_keys.size()),
+                                uint32_t(sigs[i]->first.size()),
+                                std::move(sig)});
+            m_frozen_keys += sigs[i]->first;
+        }
+        m_seeds = std::move(seeds);
+        m_salt = salt;
+        m_signals.clear();
+        compile_routes();
     }
 
     /**
-     * \brief Add a signal to the manager
-     * \param id the id of the signal to register
-     * \param fun the first receiver function for this signal (optional)
-     * \return true if the signal could be added, false if the id already exists
+     * \brief Move the signals back from the table built by freeze()
      * \defgroup signal++
      */
-    bool add(const std::string &id, signal_function fun = nullptr)
+    void thaw()
     {
-        auto sig = m_signals.find(id);
-        if (sig == m_signals.end()) {
-            m_signals[id] = signal(fun);
-            return true;
+        for (auto &slot : m_frozen) {
+            m_signals.emplace(m_frozen_keys.substr(slot.key, slot.key_len),
+                              std::move(slot.sig));
         }
-        if (fun) return sig->second.add_receiver(fun);
-        return false;
+        m_frozen.clear();
+        m_frozen.shrink_to_fit();
+        m_seeds.clear();
+        m_seeds.shrink_to_fit();
+        m_frozen_keys.clear();
+        m_frozen_keys.shrink_to_fit();
+        compile_routes();
     }
 
     /**
-     * \brief Add an object signal to the manager using a shared pointer
-     * to make sure that the object exists as long as the signal
-     * \param id the id of the signal to register
-     * \param r the receiver object for this signal
-     * \return true if the signal could be added, false if the id already exists
+     * \return true if the signal table was built by freeze()
+     * \defgroup signal++
+     */
+    bool frozen() const { return !m_frozen.empty(); }
+
+    /**
+     * \brief Memory used by the signal table, including the ids, the tree
+     * nodes and all receivers
+     * \return the memory usage in bytes
      * \defgroup signal++
      */
-    bool add(const std::string &id, std::shared_ptr<receiver> &&r)
+    size_t memory_usage() const
     {
-        auto sig = m_signals.find(id);
-        if (sig == m_signals.end()) {
-            m_signals[id] = signal(std::move(r));
-            return true;
+        /* Each tree node holds its value and a header of a color and three
+         * pointers */
+        const size_t node = sizeof(decltype(m_signals)::value_type) +
+                            4 * sizeof(void *);
+        size_t n = sizeof(*this);
+        for (const auto &sig : m_signals) {
+            n += node - sizeof(signal) + sig.second.memory_usage();
+
+            auto *key = sig.first.data();
+            auto *obj = reinterpret_cast<const char *>(&sig.first);
+            if (key < obj || key >= obj + sizeof(sig.first))
+                n += sig.first.capacity() + 1;
         }
-        return sig->second.add_receiver_obj(std::move(r));
+
+        n += m_frozen.capacity() * sizeof(frozen_slot);
+        for (const auto &slot : m_frozen)
+            n += slot.sig.memory_usage() - sizeof(signal);
+        n += m_seeds.capacity() * sizeof(uint32_t);
+        if (frozen()) n += m_frozen_keys.capacity() + 1;
+        if (m_timers) n += m_timers->wheel.memory_usage();
+        return n;
     }
 };
 }; // namespace signal
 
+template <> struct std::hash<signal::parameters> {
+    size_t operator()(const signal::parameters &p) const
+    {
+        return size_t(p.fingerprint());
+    }
+};
+
 #endif /* C++ implementation */
 
 /* C Definition */
@@ -357,6 +3947,55 @@ typedef struct signal_parameters_s signal_parameters_t;
 typedef void (*signal_function_t)(const signal_parameters_t *params,
                                   signal_parameters_t *response);
 
+/**
+ * \typedef Function pointer
+ * \brief Structure for any method called by a signal with user data
+ * \param params	Parameters sent to this method by the signal caller
+ * \param repsonse	Output data for this signal (shared by all methods)
+ * \param data	The user data pointer passed to signal_add_with_data
+ * \defgroup signal++
+ */
+typedef void (*signal_function_data_t)(const signal_parameters_t *params,
+                                       signal_parameters_t *response,
+                                       void *data);
+
+/**
+ * \enum signal_parameter_type_t
+ * \brief Value types which can be used in a signal_parameter_t
+ * \defgroup signal++
+ */
+typedef enum signal_parameter_type_e {
+    SIGNAL_PARAMETER_INT,
+    SIGNAL_PARAMETER_UINT,
+    SIGNAL_PARAMETER_BOOL,
+    SIGNAL_PARAMETER_FLOAT,
+    SIGNAL_PARAMETER_DOUBLE,
+    SIGNAL_PARAMETER_STRING,
+    SIGNAL_PARAMETER_DATA
+} signal_parameter_type_t;
+
+/**
+ * \struct signal_parameter_t
+ * \brief Describes one parameter for signal_parameters_set_many
+ * \defgroup signal++
+ */
+typedef struct signal_parameter_s {
+    const char *id;
+    signal_parameter_type_t type;
+    union {
+        int i;
+        unsigned int u;
+        bool b;
+        float f;
+        double d;
+        const char *s;
+        struct {
+            const void *ptr;
+            size_t size;
+        } data;
+    } value;
+} signal_parameter_t;
+
 /**
  * \brief Create a new signal manager, free with signal_manager_free
  * \return A new signal manager
@@ -387,6 +4026,38 @@ signal_parameters_create(void);
 extern DECLSPEC void C_SIGNAL_CALL
 signal_parameters_free(signal_parameters_t *p);
 
+/**
+ * \brief Create signal parameters inside caller provided memory, e.g. a
+ * buffer on the stack. The parameters only allocate once the buffer is
+ * full, release them with signal_parameters_free before the buffer goes
+ * out of scope
+ * \param buf the memory to use
+ * \param size the size of buf in bytes
+ * \return the parameters, or NULL if buf is NULL or too small
+ * \defgroup signal++
+ */
+extern DECLSPEC signal_parameters_t *C_SIGNAL_CALL
+signal_parameters_init(void *buf, size_t size);
+
+/**
+ * \brief Calculate a buffer size for signal_parameters_init
+ * \param count the number of parameters
+ * \param bytes the combined length of all ids and values
+ * \return the buffer size which fits these parameters without allocating
+ * \defgroup signal++
+ */
+extern DECLSPEC size_t C_SIGNAL_CALL
+signal_parameters_storage_size(size_t count, size_t bytes);
+
+/**
+ * \brief Remove all parameters from the list but keep its memory, so it can
+ * be filled again without allocating
+ * \param p the parameters to reset
+ * \defgroup signal++
+ */
+extern DECLSPEC void C_SIGNAL_CALL
+signal_parameters_reset(signal_parameters_t *p);
+
 /**
  * \brief Send a signal to all registered handlers
  * \param m the signal manager to use
@@ -413,6 +4084,93 @@ extern DECLSPEC bool C_SIGNAL_CALL signal_add(signal_manager_t *m,
                                               const char *id,
                                               signal_function_t fun);
 
+/**
+ * \brief Register a new signal handler which is called with a user data
+ * pointer
+ * \param m the signal manager to use
+ * \param id the id of the signal to register
+ * \param fun the signal handler function
+ * \param data the user data passed to fun, can be NULL
+ * \return true on success, false if m, id or fun is NULL or if the function
+ * is already registered with the same data \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_add_with_data(
+    signal_manager_t *m, const char *id, signal_function_data_t fun,
+    void *data);
+
+/**
+ * \brief Queue a send which is run by signal_process_ready, this can be
+ * called from any thread
+ * \param m the signal manager to use
+ * \param id the id of the signal
+ * \param param the parameters of the send, they are copied (can be NULL)
+ * \return true if the signal exists, false if m or id is NULL
+ * \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_post(
+    signal_manager_t *m, const char *id, const signal_parameters_t *param);
+
+/**
+ * \brief Get a file descriptor which is readable while posted sends are
+ * queued, for use with poll/epoll
+ * \param m the signal manager to use
+ * \return the file descriptor, -1 if m is NULL or the platform has no
+ * eventfd \defgroup signal++
+ */
+extern DECLSPEC int C_SIGNAL_CALL signal_manager_get_fd(signal_manager_t *m);
+
+/**
+ * \brief Run the sends queued by signal_post on this thread
+ * \param m the signal manager to use
+ * \param max_items the maximum number of sends to run
+ * \return the number of sends which were run, expired ones are not counted
+ * \defgroup signal++
+ */
+extern DECLSPEC size_t C_SIGNAL_CALL
+signal_process_ready(signal_manager_t *m, size_t max_items);
+
+/**
+ * \brief Put a signal into groups which can be muted together
+ * \param m the signal manager to use
+ * \param id the id of the signal
+ * \param groups one bit per group, 0 removes the signal from all groups
+ * \return true if the signal exists, false if it doesn't or m or id is NULL
+ * \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_set_groups(signal_manager_t *m,
+                                                     const char *id,
+                                                     uint64_t groups);
+
+/**
+ * \brief Skip all sends of signals in the given groups, this can be called
+ * from any thread
+ * \param m the signal manager to use
+ * \param groups one bit per group
+ * \defgroup signal++
+ */
+extern DECLSPEC void C_SIGNAL_CALL signal_mute(signal_manager_t *m,
+                                               uint64_t groups);
+
+/**
+ * \brief Send the signals of the given groups again, see signal_mute
+ * \param m the signal manager to use
+ * \param groups one bit per group
+ * \defgroup signal++
+ */
+extern DECLSPEC void C_SIGNAL_CALL signal_unmute(signal_manager_t *m,
+                                                 uint64_t groups);
+
+/**
+ * \brief Get the number of sends which were skipped because a group of the
+ * signal was muted
+ * \param m the signal manager to use
+ * \param id the id of the signal
+ * \return the number of skipped sends, 0 if m or id is NULL
+ * \defgroup signal++
+ */
+extern DECLSPEC uint64_t C_SIGNAL_CALL
+signal_get_muted_count(signal_manager_t *m, const char *id);
+
 /**
  * \brief Add an integer variable to the parameter list
  * \param p the parameter list to use
@@ -491,6 +4249,18 @@ extern DECLSPEC bool C_SIGNAL_CALL signal_parameters_set_string(
 extern DECLSPEC bool C_SIGNAL_CALL signal_parameters_set_data(
     signal_parameters_t *p, const char *id, void *val, size_t size);
 
+/**
+ * \brief Add several parameters at once, space for all of them is reserved
+ * up front
+ * \param p the parameter list to use
+ * \param params the parameters to add
+ * \param count the number of entries in params
+ * \return the number of parameters which could be added
+ * \defgroup signal++
+ */
+extern DECLSPEC size_t C_SIGNAL_CALL signal_parameters_set_many(
+    signal_parameters_t *p, const signal_parameter_t *params, size_t count);
+
 /**
  * \brief Get an integer variable from the parameter list
  * \param p the parameter list to use
@@ -562,6 +4332,85 @@ extern DECLSPEC const char *C_SIGNAL_CALL signal_parameters_get_string(
 extern DECLSPEC const void *C_SIGNAL_CALL signal_parameters_get_data(
     const signal_parameters_t *p, const char *id, bool *ok);
 
+/**
+ * \brief Alignment in bytes of arrays added with the array setters
+ * \defgroup signal++
+ */
+#define SIGNAL_PARAMETERS_ARRAY_ALIGN 64
+
+/**
+ * \brief Add a copy of a float array to the parameter list, the copy is
+ * aligned to SIGNAL_PARAMETERS_ARRAY_ALIGN bytes
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param val the first element of the array
+ * \param count the number of elements
+ * \return true on success, false if p or id is NULL or if the variable
+ * already exists \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_parameters_set_float_array(
+    signal_parameters_t *p, const char *id, const float *val, size_t count);
+
+/**
+ * \brief Add a copy of a double array to the parameter list, the copy is
+ * aligned to SIGNAL_PARAMETERS_ARRAY_ALIGN bytes
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param val the first element of the array
+ * \param count the number of elements
+ * \return true on success, false if p or id is NULL or if the variable
+ * already exists \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_parameters_set_double_array(
+    signal_parameters_t *p, const char *id, const double *val, size_t count);
+
+/**
+ * \brief Add a copy of an integer array to the parameter list, the copy is
+ * aligned to SIGNAL_PARAMETERS_ARRAY_ALIGN bytes
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param val the first element of the array
+ * \param count the number of elements
+ * \return true on success, false if p or id is NULL or if the variable
+ * already exists \defgroup signal++
+ */
+extern DECLSPEC bool C_SIGNAL_CALL signal_parameters_set_int_array(
+    signal_parameters_t *p, const char *id, const int *val, size_t count);
+
+/**
+ * \brief Get a float array from the parameter list
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param count will be set to the number of elements, can be NULL
+ * \return the first element of the array, or NULL if it doesn't exist or
+ * if the size of its elements doesn't match \defgroup signal++
+ */
+extern DECLSPEC const float *C_SIGNAL_CALL signal_parameters_get_float_array(
+    const signal_parameters_t *p, const char *id, size_t *count);
+
+/**
+ * \brief Get a double array from the parameter list
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param count will be set to the number of elements, can be NULL
+ * \return the first element of the array, or NULL if it doesn't exist or
+ * if the size of its elements doesn't match \defgroup signal++
+ */
+extern DECLSPEC const double *C_SIGNAL_CALL
+signal_parameters_get_double_array(const signal_parameters_t *p,
+                                   const char *id, size_t *count);
+
+/**
+ * \brief Get an integer array from the parameter list
+ * \param p the parameter list to use
+ * \param id the id of the parameter
+ * \param count will be set to the number of elements, can be NULL
+ * \return the first element of the array, or NULL if it doesn't exist or
+ * if the size of its elements doesn't match \defgroup signal++
+ */
+extern DECLSPEC const int *C_SIGNAL_CALL signal_parameters_get_int_array(
+    const signal_parameters_t *p, const char *id, size_t *count);
+
 #ifdef __cplusplus
 }
 #endif /* extern "c" */
@@ -0,0 +1,326 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Real-time profile for sending from threads which must not block, e.g.
+ * audio callbacks. An rt_manager keeps its signals and receivers in fixed
+ * arrays sized at compile time, so sending never allocates, never locks
+ * and runs at most MaxReceivers receivers. Receivers which can't run on
+ * the real-time thread are added with add_deferred(), their sends are
+ * handed over through a wait-free single producer single consumer queue
+ * and run by process_deferred() on another thread. Adding receivers
+ * allocates and has to be done before sending starts */
+
+#ifndef LIB_SIGNAL_REALTIME_H
+#define LIB_SIGNAL_REALTIME_H
+
+#include "static_manager.h"
+#include <array>
+
+namespace signal
+{
+/**
+ * \brief Parameters stored in an inline buffer of Size bytes, adding values
+ * fails once it is full instead of allocating. Copying values which
+ * allocate themselves, e.g. std::string, still allocates
+ * \defgroup signal++
+ */
+template <size_t Size> class fixed_parameters : public parameters
+{
+    alignas(parameters::array_align) unsigned char m_buffer[Size];
+
+  public:
+    fixed_parameters() : parameters(m_buffer, Size, true) {}
+    fixed_parameters(const parameters &o) : fixed_parameters() { assign(o); }
+    fixed_parameters(const fixed_parameters &o) : fixed_parameters()
+    {
+        assign(o);
+    }
+
+    fixed_parameters &operator=(const parameters &o)
+    {
+        assign(o);
+        return *this;
+    }
+
+    fixed_parameters &operator=(const fixed_parameters &o)
+    {
+        assign(o);
+        return *this;
+    }
+};
+
+/**
+ * \brief Wait-free queue for one producer and one consumer thread. The
+ * items are constructed once and reused, so pushing into an item which
+ * keeps its memory, like fixed_parameters, doesn't allocate
+ * \defgroup signal++
+ */
+template <class T, size_t Capacity> class spsc_queue
+{
+    static_assert(Capacity && !(Capacity & (Capacity - 1)),
+                  "The capacity has to be a power of two");
+
+    /* Separate cache lines so the threads don't invalidate each other */
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::array<T, Capacity> m_items;
+
+  public:
+    /**
+     * \brief Fill the next free item, only call this from the producer
+     * \param fill called with the item, returns false to discard it
+     * \return false if the queue is full or the item was discarded
+     * \defgroup signal++
+     */
+    template <class F> bool try_push(const F &fill)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+            return false;
+        if (!fill(m_items[tail & (Capacity - 1)])) return false;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief Take the oldest item, only call this from the consumer
+     * \param consume called with the item, it is reused afterwards
+     * \return false if the queue is empty
+     * \defgroup signal++
+     */
+    template <class F> bool try_pop(const F &consume)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) return false;
+        consume(m_items[head & (Capacity - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \return the number of queued items, only exact if neither thread
+     * changes the queue
+     * \defgroup signal++
+     */
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) -
+               m_head.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * \brief Manager with a fixed capacity whose sends don't allocate or lock
+ * \tparam MaxSignals the maximum number of signals
+ * \tparam MaxReceivers the maximum number of receivers of all signals,
+ * separately for real-time and deferred receivers
+ * \tparam QueueSize the number of deferred sends which can be pending
+ * \tparam ParamSize the buffer size of a deferred send's parameters
+ * \class rt_manager
+ * \defgroup signal++
+ */
+template <size_t MaxSignals, size_t MaxReceivers, size_t QueueSize = 64,
+          size_t ParamSize = 256>
+class rt_manager
+{
+    /* Open addressing table with at least half of the slots empty */
+    static constexpr size_t table_size = [] {
+        size_t n = 1;
+        while (n < MaxSignals * 2)
+            n <<= 1;
+        return n;
+    }();
+
+    struct slot {
+        signal_id id;
+        bool used = false;
+        uint32_t first = 0, count = 0;       /* real-time receivers */
+        uint32_t deferred = 0, deferred_count = 0;
+    };
+
+    struct pending {
+        signal_id id;
+        fixed_parameters<ParamSize> params;
+    };
+
+    std::array<slot, table_size> m_table;
+    std::array<delegate, MaxReceivers> m_receivers;
+    std::array<delegate, MaxReceivers> m_deferred;
+    uint32_t m_signal_count = 0, m_receiver_count = 0, m_deferred_count = 0;
+    mutable spsc_queue<pending, QueueSize> m_queue;
+    mutable std::atomic<uint64_t> m_dropped{0};
+
+    const slot *find(signal_id id) const
+    {
+        size_t i = size_t(id) & (table_size - 1);
+        for (size_t n = 0; n < table_size; n++) {
+            const slot &s = m_table[(i + n) & (table_size - 1)];
+            if (!s.used) return nullptr;
+            if (s.id == id) return &s;
+        }
+        return nullptr;
+    }
+
+    slot *find_or_add(signal_id id)
+    {
+        if (auto *s = find(id)) return const_cast<slot *>(s);
+        if (m_signal_count == MaxSignals) return nullptr;
+
+        size_t i = size_t(id) & (table_size - 1);
+        while (m_table[i].used)
+            i = (i + 1) & (table_size - 1);
+        m_table[i].id = id;
+        m_table[i].used = true;
+        m_signal_count++;
+        return &m_table[i];
+    }
+
+    /* Receivers of a signal are stored next to each other, inserting one
+     * moves the receivers of the signals behind it */
+    static bool insert(std::array<delegate, MaxReceivers> &list,
+                       uint32_t &size, std::array<slot, table_size> &table,
+                       uint32_t slot::*first, uint32_t slot::*count,
+                       slot &s, delegate &&d)
+    {
+        if (!d || size == MaxReceivers) return false;
+        if (!(s.*count)) s.*first = size;
+        for (uint32_t i = s.*first; i < s.*first + s.*count; i++) {
+            if (list[i] == d) return false;
+        }
+
+        const uint32_t at = s.*first + s.*count;
+        for (uint32_t i = size; i > at; i--)
+            list[i] = std::move(list[i - 1]);
+        list[at] = std::move(d);
+        size++;
+        for (auto &other : table) {
+            if (&other != &s && other.*count && other.*first >= at)
+                other.*first += 1;
+        }
+        s.*count += 1;
+        return true;
+    }
+
+  public:
+    /**
+     * \brief Add a receiver which runs on the sending thread, it must not
+     * allocate or block. This allocates and must not be called while
+     * sending
+     * \return false if the manager is full, d is empty or already added
+     * \defgroup signal++
+     */
+    bool add(signal_id id, delegate d)
+    {
+        slot *s = find_or_add(id);
+        return s && insert(m_receivers, m_receiver_count, m_table,
+                           &slot::first, &slot::count, *s, std::move(d));
+    }
+
+    bool add(std::string_view id, delegate d)
+    {
+        return add(make_id(id), std::move(d));
+    }
+
+    /**
+     * \brief Add a receiver which runs in process_deferred(), sends copy
+     * their parameters into the queue if a signal has deferred receivers
+     * \return see add()
+     * \defgroup signal++
+     */
+    bool add_deferred(signal_id id, delegate d)
+    {
+        slot *s = find_or_add(id);
+        return s && insert(m_deferred, m_deferred_count, m_table,
+                           &slot::deferred, &slot::deferred_count, *s,
+                           std::move(d));
+    }
+
+    bool add_deferred(std::string_view id, delegate d)
+    {
+        return add_deferred(make_id(id), std::move(d));
+    }
+
+    /**
+     * \brief Send a signal, this doesn't allocate or lock as long as the
+     * receivers don't. Only one thread may send signals with deferred
+     * receivers
+     * \param id the id of the signal
+     * \param param the parameters
+     * \param response the response shared by the real-time receivers
+     * \return true if the signal exists. Deferred sends which don't fit into
+     * the queue are dropped and counted in dropped()
+     * \defgroup signal++
+     */
+    bool send(signal_id id, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        const slot *s = find(id);
+        if (!s) return false;
+        for (uint32_t i = s->first; i < s->first + s->count; i++)
+            m_receivers[i](param, response);
+
+        if (s->deferred_count &&
+            !m_queue.try_push([&](pending &p) {
+                p.id = id;
+                return p.params.assign(param);
+            }))
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool send(std::string_view id, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        return send(make_id(id), param, response);
+    }
+
+    /**
+     * \brief Run the deferred receivers of queued sends, call this from one
+     * thread which isn't real-time
+     * \param max_items the maximum number of sends to run
+     * \return the number of sends
+     * \defgroup signal++
+     */
+    size_t process_deferred(
+        size_t max_items = std::numeric_limits<size_t>::max())
+    {
+        size_t n = 0;
+        while (n < max_items && m_queue.try_pop([this](const pending &p) {
+            const slot *s = find(p.id);
+            for (uint32_t i = s->deferred;
+                 i < s->deferred + s->deferred_count; i++)
+                m_deferred[i](p.params, nullptr);
+        }))
+            n++;
+        return n;
+    }
+
+    /**
+     * \return the number of deferred sends dropped because the queue was
+     * full or their parameters didn't fit
+     * \defgroup signal++
+     */
+    uint64_t dropped() const
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+};
+}; // namespace signal
+
+#endif /* Header guard */
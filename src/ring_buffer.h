@@ -0,0 +1,303 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Multicast ring buffer in the style of the LMAX Disruptor. One producer
+ * publishes parameters into a preallocated ring of slots and every
+ * consumer sees every event in order. Each consumer has its own sequence
+ * counter and processes all slots published since its last run as one
+ * batch, consumers can also wait for another consumer to form pipeline
+ * stages. The producer waits once the slowest consumer is a whole ring
+ * behind. Slots keep their memory, so publishing doesn't allocate once
+ * every slot has been used */
+
+#ifndef LIB_SIGNAL_RING_BUFFER_H
+#define LIB_SIGNAL_RING_BUFFER_H
+
+#include "libsignal.h"
+
+namespace signal
+{
+/**
+ * \brief How consumers wait for events and the producer for free slots
+ * \defgroup signal++
+ */
+enum class wait_strategy {
+    busy_spin, /* lowest latency, keeps a core busy */
+    yield,     /* spins but lets other threads run */
+    block      /* sleeps on a condition variable, idle threads cost nothing */
+};
+
+/**
+ * \brief Disruptor style ring buffer, see the top of ring_buffer.h
+ * \class ring_buffer
+ * \defgroup signal++
+ */
+class ring_buffer
+{
+    /* Sequences live on their own cache line so the threads updating them
+     * don't slow each other down */
+    struct alignas(64) sequence {
+        std::atomic<int64_t> value{-1};
+    };
+
+    struct consumer {
+        sequence seq;
+        delegate handler;
+        const sequence *barrier;
+        std::thread thread;
+    };
+
+    std::vector<parameters> m_slots;
+    const size_t m_mask;
+    const wait_strategy m_strategy;
+    sequence m_cursor;
+    int64_t m_next = 0, m_gate = -1;
+    std::vector<std::unique_ptr<consumer>> m_consumers;
+    std::atomic<bool> m_running{false};
+
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::atomic<int> m_waiting{0};
+
+    template <class F> void wait(const F &ready)
+    {
+        switch (m_strategy) {
+        case wait_strategy::busy_spin:
+            while (!ready())
+                ;
+            break;
+        case wait_strategy::yield:
+            while (!ready())
+                std::this_thread::yield();
+            break;
+        case wait_strategy::block:
+            if (ready()) break;
+            /* The waiting counter and the sequences are sequentially
+             * consistent, so either the waiter sees the new sequence or the
+             * notifier sees the waiter */
+            m_waiting.fetch_add(1);
+            {
+                std::unique_lock<std::mutex> lock(m_lock);
+                m_wake.wait(lock, ready);
+            }
+            m_waiting.fetch_sub(1);
+            break;
+        }
+    }
+
+    void notify()
+    {
+        if (m_strategy == wait_strategy::block && m_waiting.load()) {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_wake.notify_all();
+        }
+    }
+
+    /* Waits until the slot of the next sequence isn't read anymore */
+    int64_t claim()
+    {
+        const int64_t wrap = m_next - int64_t(m_slots.size());
+        if (wrap > m_gate) {
+            auto slowest = [this] {
+                int64_t min = m_cursor.value.load();
+                for (const auto &c : m_consumers)
+                    min = std::min(min, c->seq.value.load());
+                return min;
+            };
+            wait([&] { return (m_gate = slowest()) >= wrap; });
+        }
+        return m_next;
+    }
+
+    void commit(int64_t seq)
+    {
+        m_next = seq + 1;
+        m_cursor.value.store(seq);
+        notify();
+    }
+
+    /* Runs the handler for all slots published since the last run */
+    size_t run_batch(consumer &c)
+    {
+        const int64_t from = c.seq.value.load(std::memory_order_relaxed);
+        const int64_t to = c.barrier->value.load();
+        if (to <= from) return 0;
+        for (int64_t seq = from + 1; seq <= to; seq++)
+            c.handler(m_slots[size_t(seq) & m_mask], nullptr);
+        c.seq.value.store(to);
+        notify();
+        return size_t(to - from);
+    }
+
+    struct publish_receiver {
+        ring_buffer *ring;
+
+        void operator()(const parameters &p, parameters *) const
+        {
+            ring->publish(p);
+        }
+
+        bool operator==(const publish_receiver &o) const
+        {
+            return ring == o.ring;
+        }
+    };
+
+  public:
+    /**
+     * \param size the number of slots, rounded up to a power of two
+     * \param slot_bytes the memory reserved in every slot
+     * \param strategy how threads wait, see wait_strategy
+     * \defgroup signal++
+     */
+    ring_buffer(size_t size, size_t slot_bytes = 256,
+                wait_strategy strategy = wait_strategy::yield)
+        : m_slots([size] {
+              size_t n = 1;
+              while (n < size)
+                  n <<= 1;
+              return n;
+          }()),
+          m_mask(m_slots.size() - 1), m_strategy(strategy)
+    {
+        for (auto &slot : m_slots)
+            slot.reserve(slot_bytes);
+    }
+
+    ring_buffer(const ring_buffer &) = delete;
+    ring_buffer &operator=(const ring_buffer &) = delete;
+    ~ring_buffer() { stop(); }
+
+    /**
+     * \brief Add a consumer, this must be done before publishing
+     * \param handler called with the parameters of every event
+     * \param after the index of a consumer which has to process an event
+     * before this one, -1 to only wait for the producer
+     * \return the index of the consumer
+     * \defgroup signal++
+     */
+    size_t add_consumer(delegate handler, int after = -1)
+    {
+        auto c = std::make_unique<consumer>();
+        c->handler = std::move(handler);
+        c->barrier = after < 0 ? &m_cursor : &m_consumers[size_t(after)]->seq;
+        m_consumers.push_back(std::move(c));
+        return m_consumers.size() - 1;
+    }
+
+    /**
+     * \brief Run every consumer on its own thread until stop()
+     * \defgroup signal++
+     */
+    void start()
+    {
+        if (m_running.exchange(true)) return;
+        for (auto &c : m_consumers) {
+            consumer *self = c.get();
+            c->thread = std::thread([this, self] {
+                for (;;) {
+                    if (run_batch(*self)) continue;
+                    if (!m_running.load() &&
+                        self->seq.value.load() == m_cursor.value.load())
+                        break;
+                    wait([this, self] {
+                        return !m_running.load() ||
+                               self->barrier->value.load() >
+                                   self->seq.value.load(
+                                       std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+    }
+
+    /**
+     * \brief Stop the consumer threads once they processed all published
+     * events
+     * \defgroup signal++
+     */
+    void stop()
+    {
+        if (!m_running.exchange(false)) return;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_wake.notify_all();
+        }
+        for (auto &c : m_consumers) {
+            if (c->thread.joinable()) c->thread.join();
+        }
+    }
+
+    /**
+     * \brief Process the published events on this thread, for consumers
+     * which aren't run by start()
+     * \param index the index of the consumer
+     * \return the number of processed events
+     * \defgroup signal++
+     */
+    size_t poll(size_t index) { return run_batch(*m_consumers[index]); }
+
+    /**
+     * \brief Publish a copy of p, only call this from one thread. Waits
+     * while the ring is full
+     * \defgroup signal++
+     */
+    void publish(const parameters &p)
+    {
+        publish_with([&p](parameters &slot) { slot = p; });
+    }
+
+    /**
+     * \brief Publish an event by filling its slot in place, saving the copy
+     * of publish()
+     * \param fill called with the empty parameters of the slot
+     * \defgroup signal++
+     */
+    template <class F> void publish_with(const F &fill)
+    {
+        const int64_t seq = claim();
+        auto &slot = m_slots[size_t(seq) & m_mask];
+        slot.reset();
+        fill(slot);
+        commit(seq);
+    }
+
+    /**
+     * \brief Get a receiver which publishes its parameters, to register the
+     * ring on a manager with manager::add(id, ring.publisher()). The
+     * signal must only be sent from one thread
+     * \defgroup signal++
+     */
+    delegate publisher() { return delegate(publish_receiver{this}); }
+
+    /**
+     * \return the number of published events
+     * \defgroup signal++
+     */
+    uint64_t published() const { return uint64_t(m_cursor.value.load() + 1); }
+
+    /**
+     * \return the number of slots
+     * \defgroup signal++
+     */
+    size_t size() const { return m_slots.size(); }
+};
+}; // namespace signal
+
+#endif /* Header guard */
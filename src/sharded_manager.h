@@ -0,0 +1,235 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Manager for heavy concurrent registration. Signal ids are spread over
+ * independently locked shards by their hash, so adding and removing
+ * receivers of unrelated signals from different threads doesn't contend.
+ * The receivers of a signal are kept in immutable chunks, a change copies
+ * the chunk it touches and the list of chunk pointers, so it costs
+ * O(chunk_size + receivers / chunk_size) copies instead of copying every
+ * receiver. Sends copy the list pointer under a short shared lock and run
+ * the receivers without holding any lock. A send running while receivers
+ * are added or removed therefore sees either the old or the new receivers.
+ *
+ * Only plain receivers are supported. Filtered receivers, send policies,
+ * distinct, sticky and memoized signals, groups, counters and connect()
+ * routes belong to manager and have no equivalent here */
+
+#ifndef LIB_SIGNAL_SHARDED_MANAGER_H
+#define LIB_SIGNAL_SHARDED_MANAGER_H
+
+#include "libsignal.h"
+#include <shared_mutex>
+
+namespace signal
+{
+/**
+ * \brief Thread safe manager, see the top of sharded_manager.h
+ * \class sharded_manager
+ * \defgroup signal++
+ */
+class sharded_manager
+{
+  public:
+    /* Most receivers a chunk holds */
+    static constexpr size_t chunk_size = 64;
+
+  private:
+    typedef std::shared_ptr<const std::vector<delegate>> chunk;
+    typedef std::shared_ptr<const std::vector<chunk>> snapshot;
+
+    /* One cache line per shard lock so shards don't share lines */
+    struct alignas(64) shard {
+        mutable std::shared_mutex lock;
+        std::map<std::string, snapshot, std::less<>> signals;
+    };
+
+    std::vector<shard> m_shards;
+
+    size_t index(std::string_view id) const
+    {
+        return parameters::hash(id) % m_shards.size();
+    }
+
+    shard &shard_of(std::string_view id) { return m_shards[index(id)]; }
+
+    const shard &shard_of(std::string_view id) const
+    {
+        return m_shards[index(id)];
+    }
+
+    snapshot get(std::string_view id) const
+    {
+        auto &s = shard_of(id);
+        std::shared_lock<std::shared_mutex> lock(s.lock);
+        auto sig = s.signals.find(id);
+        return sig == s.signals.end() ? snapshot() : sig->second;
+    }
+
+    /* Copy of the chunk list of a snapshot, the chunks themselves are
+     * shared */
+    static std::vector<chunk> chunks_of(const snapshot &sig)
+    {
+        return sig ? *sig : std::vector<chunk>();
+    }
+
+  public:
+    /**
+     * \param shards the number of shards, a few times the number of threads
+     * changing receivers works well
+     * \defgroup signal++
+     */
+    explicit sharded_manager(size_t shards = 64)
+        : m_shards(std::max<size_t>(shards, 1))
+    {
+    }
+
+    /**
+     * \brief Add a receiver, this can be called from any thread
+     * \param id the id of the signal, it is registered if it doesn't exist
+     * \param d the receiver (optional)
+     * \return see manager::add()
+     * \defgroup signal++
+     */
+    bool add(std::string_view id, delegate d = delegate())
+    {
+        auto &s = shard_of(id);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        auto sig = s.signals.find(id);
+        if (sig == s.signals.end()) {
+            sig = s.signals.emplace(id, snapshot()).first;
+            if (!d) {
+                sig->second = std::make_shared<std::vector<chunk>>();
+                return true;
+            }
+        } else if (!d) {
+            return false;
+        }
+
+        auto chunks = chunks_of(sig->second);
+        for (const auto &c : chunks) {
+            if (std::find(c->begin(), c->end(), d) != c->end())
+                return false;
+        }
+
+        /* Only the last chunk is copied, a full one starts a new chunk */
+        std::vector<delegate> last;
+        if (!chunks.empty() && chunks.back()->size() < chunk_size) {
+            last.reserve(chunks.back()->size() + 1);
+            last = *chunks.back();
+            chunks.pop_back();
+        }
+        last.emplace_back(std::move(d));
+        chunks.emplace_back(
+            std::make_shared<const std::vector<delegate>>(std::move(last)));
+        sig->second = std::make_shared<const std::vector<chunk>>(
+            std::move(chunks));
+        return true;
+    }
+
+    /**
+     * \brief Remove a receiver, this can be called from any thread. Sends
+     * which started before may still call it
+     * \param id the id of the signal
+     * \param d a receiver equal to the one to remove
+     * \return true if the receiver was found
+     * \defgroup signal++
+     */
+    bool remove(std::string_view id, const delegate &d)
+    {
+        auto &s = shard_of(id);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        auto sig = s.signals.find(id);
+        if (sig == s.signals.end()) return false;
+
+        auto chunks = chunks_of(sig->second);
+        for (auto c = chunks.begin(); c != chunks.end(); ++c) {
+            auto match = std::find((*c)->begin(), (*c)->end(), d);
+            if (match == (*c)->end()) continue;
+
+            /* Only the chunk holding the receiver is copied */
+            if ((*c)->size() == 1) {
+                chunks.erase(c);
+            } else {
+                std::vector<delegate> rest;
+                rest.reserve((*c)->size() - 1);
+                rest.insert(rest.end(), (*c)->begin(), match);
+                rest.insert(rest.end(), match + 1, (*c)->end());
+                *c = std::make_shared<const std::vector<delegate>>(
+                    std::move(rest));
+            }
+            sig->second = std::make_shared<const std::vector<chunk>>(
+                std::move(chunks));
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * \brief Remove a signal and all of its receivers
+     * \return true if the signal existed
+     * \defgroup signal++
+     */
+    bool remove(std::string_view id)
+    {
+        auto &s = shard_of(id);
+        std::unique_lock<std::shared_mutex> lock(s.lock);
+        auto sig = s.signals.find(id);
+        if (sig == s.signals.end()) return false;
+        s.signals.erase(sig);
+        return true;
+    }
+
+    /**
+     * \brief Send a signal, this can be called from any thread. The
+     * receivers are called in the order they were added in
+     * \return true if the signal exists
+     * \defgroup signal++
+     */
+    bool send(std::string_view id, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        auto sig = get(id);
+        if (!sig) return false;
+        for (const auto &c : *sig) {
+            for (const auto &recv : *c)
+                recv(param, response);
+        }
+        return true;
+    }
+
+    /**
+     * \return true if the signal exists and has at least one receiver
+     * \defgroup signal++
+     */
+    bool has_receivers(std::string_view id) const
+    {
+        auto sig = get(id);
+        return sig && !sig->empty();
+    }
+
+    /**
+     * \return the number of shards
+     * \defgroup signal++
+     */
+    size_t shard_count() const { return m_shards.size(); }
+};
+}; // namespace signal
+
+#endif /* Header guard */
@@ -0,0 +1,337 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Publishes the counters of a manager into a named POSIX shared memory
+ * segment, so tools like signal_top can watch a running process. Enable
+ * the counters with manager::set_counters() and call publish() every now
+ * and then, e.g. from a send_every() timer. Sends only touch the counters,
+ * never the segment.
+ *
+ * Every record is guarded by a seqlock: the publisher makes the sequence
+ * odd, stores the fields and makes it even again. Readers copy the record
+ * and retry if the sequence was odd or changed meanwhile, so they never
+ * block the publisher. Linux and other POSIX systems only */
+
+#ifndef LIB_SIGNAL_SHM_STATS_H
+#define LIB_SIGNAL_SHM_STATS_H
+
+#include "libsignal.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace signal
+{
+/**
+ * \brief The counters of one signal read from a stats segment
+ * \struct stats_record
+ * \defgroup signal++
+ */
+struct stats_record {
+    static constexpr size_t id_size = 64;
+
+    char id[id_size]; /* truncated and zero terminated */
+    signal_stats stats;
+};
+
+namespace shm
+{
+static constexpr uint32_t magic = 0x5349474e; /* "SIGN" */
+static constexpr uint32_t version = 2;
+
+/* Ids, counters and latency buckets of a record as 64 bit words */
+static constexpr size_t id_words = stats_record::id_size / 8;
+static constexpr size_t counter_words = 8;
+static constexpr size_t record_words =
+    id_words + counter_words + signal_stats::latency_buckets;
+
+struct slot {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> words[record_words];
+};
+
+struct header {
+    uint32_t magic, version;
+    uint64_t capacity, pid;
+    std::atomic<uint64_t> count;     /* records in use */
+    std::atomic<uint64_t> published; /* publish() calls */
+};
+
+inline size_t segment_size(size_t capacity)
+{
+    return sizeof(header) + capacity * sizeof(slot);
+}
+
+inline slot *slots(header *h) { return reinterpret_cast<slot *>(h + 1); }
+
+inline const slot *slots(const header *h)
+{
+    return reinterpret_cast<const slot *>(h + 1);
+}
+
+inline void pack(std::string_view id, const signal_stats &s,
+                 uint64_t *words)
+{
+    char name[stats_record::id_size] = {};
+    memcpy(name, id.data(), std::min(id.size(), sizeof(name) - 1));
+    memcpy(words, name, sizeof(name));
+    uint64_t *w = words + id_words;
+    w[0] = s.dropped;
+    w[1] = s.suppressed;
+    w[2] = s.receivers;
+    w[3] = s.sends;
+    w[4] = s.misses;
+    w[5] = s.muted;
+    w[6] = s.cache_hits;
+    w[7] = s.cache_misses;
+    memcpy(w + counter_words, s.latency, sizeof(s.latency));
+}
+
+inline void unpack(const uint64_t *words, stats_record &r)
+{
+    memcpy(r.id, words, sizeof(r.id));
+    r.id[sizeof(r.id) - 1] = 0;
+    const uint64_t *w = words + id_words;
+    r.stats.dropped = w[0];
+    r.stats.suppressed = w[1];
+    r.stats.receivers = w[2];
+    r.stats.sends = w[3];
+    r.stats.misses = w[4];
+    r.stats.muted = w[5];
+    r.stats.cache_hits = w[6];
+    r.stats.cache_misses = w[7];
+    memcpy(r.stats.latency, w + counter_words, sizeof(r.stats.latency));
+}
+}; // namespace shm
+
+/**
+ * \brief Creates a stats segment and writes the counters of a manager to
+ * it, see the top of shm_stats.h. The segment is removed again by the
+ * destructor
+ * \class stats_publisher
+ * \defgroup signal++
+ */
+class stats_publisher
+{
+    std::string m_name;
+    shm::header *m_header = nullptr;
+    size_t m_capacity;
+
+  public:
+    /**
+     * \param name the name of the segment, e.g. "/libsignal.1234". The
+     * default uses the process id, which is what signal_top looks for
+     * \param capacity the most signals which are published
+     * \defgroup signal++
+     */
+    explicit stats_publisher(std::string name = std::string(),
+                             size_t capacity = 1024)
+        : m_name(std::move(name)), m_capacity(capacity)
+    {
+        if (m_name.empty()) m_name = "/libsignal." + std::to_string(getpid());
+        int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return;
+
+        const size_t size = shm::segment_size(capacity);
+        void *p = MAP_FAILED;
+        if (ftruncate(fd, off_t(size)) == 0)
+            p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                     0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            shm_unlink(m_name.c_str());
+            return;
+        }
+
+        /* A fresh segment is zero filled, which is a valid empty state for
+         * the atomics */
+        m_header = static_cast<shm::header *>(p);
+        m_header->capacity = capacity;
+        m_header->pid = uint64_t(getpid());
+        m_header->version = shm::version;
+        m_header->count.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = shm::magic;
+    }
+
+    stats_publisher(const stats_publisher &) = delete;
+    stats_publisher &operator=(const stats_publisher &) = delete;
+
+    ~stats_publisher()
+    {
+        if (!m_header) return;
+        munmap(m_header, shm::segment_size(m_capacity));
+        shm_unlink(m_name.c_str());
+    }
+
+    /**
+     * \return true if the segment was created
+     * \defgroup signal++
+     */
+    bool ok() const { return m_header != nullptr; }
+
+    /**
+     * \return the name of the segment
+     * \defgroup signal++
+     */
+    const std::string &name() const { return m_name; }
+
+    /**
+     * \brief Write the counters of all signals of m to the segment. This
+     * must not be called while receivers are added from another thread,
+     * sends may run meanwhile
+     * \return the number of published signals, signals beyond the capacity
+     * are left out
+     * \defgroup signal++
+     */
+    size_t publish(const manager &m)
+    {
+        if (!m_header) return 0;
+        size_t n = 0;
+        uint64_t words[shm::record_words];
+        shm::slot *slots = shm::slots(m_header);
+        m.for_each_stats([&](std::string_view id, const signal_stats &s) {
+            if (n == m_capacity) return;
+            shm::pack(id, s, words);
+
+            auto &slot = slots[n++];
+            uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+            slot.seq.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < shm::record_words; i++)
+                slot.words[i].store(words[i], std::memory_order_relaxed);
+            slot.seq.store(seq + 2, std::memory_order_release);
+        });
+        m_header->count.store(n, std::memory_order_release);
+        m_header->published.fetch_add(1, std::memory_order_release);
+        return n;
+    }
+};
+
+/**
+ * \brief Attaches to a stats segment of another process and reads its
+ * records
+ * \class stats_reader
+ * \defgroup signal++
+ */
+class stats_reader
+{
+    const shm::header *m_header = nullptr;
+    size_t m_size = 0;
+
+  public:
+    /**
+     * \param name the name the stats_publisher used
+     * \defgroup signal++
+     */
+    explicit stats_reader(const std::string &name)
+    {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return;
+
+        struct stat st;
+        void *p = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(shm::header))
+            p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd,
+                     0);
+        close(fd);
+        if (p == MAP_FAILED) return;
+
+        auto *header = static_cast<const shm::header *>(p);
+        if (header->magic != shm::magic || header->version != shm::version ||
+            shm::segment_size(header->capacity) > size_t(st.st_size)) {
+            munmap(p, size_t(st.st_size));
+            return;
+        }
+        m_header = header;
+        m_size = size_t(st.st_size);
+    }
+
+    stats_reader(const stats_reader &) = delete;
+    stats_reader &operator=(const stats_reader &) = delete;
+
+    ~stats_reader()
+    {
+        if (m_header) munmap(const_cast<shm::header *>(m_header), m_size);
+    }
+
+    /**
+     * \return true if the segment could be attached
+     * \defgroup signal++
+     */
+    bool ok() const { return m_header != nullptr; }
+
+    /**
+     * \return the process id of the publisher
+     * \defgroup signal++
+     */
+    uint64_t pid() const { return m_header ? m_header->pid : 0; }
+
+    /**
+     * \return the number of publish() calls so far
+     * \defgroup signal++
+     */
+    uint64_t published() const
+    {
+        return m_header ? m_header->published.load(std::memory_order_acquire)
+                        : 0;
+    }
+
+    /**
+     * \return the number of records
+     * \defgroup signal++
+     */
+    size_t size() const
+    {
+        if (!m_header) return 0;
+        return size_t(std::min<uint64_t>(
+            m_header->count.load(std::memory_order_acquire),
+            m_header->capacity));
+    }
+
+    /**
+     * \brief Copy a record, retries while the publisher writes it
+     * \param index the index of the record, below size()
+     * \param out the copy
+     * \return false if the index is out of range or the record kept
+     * changing
+     * \defgroup signal++
+     */
+    bool read(size_t index, stats_record &out) const
+    {
+        if (index >= size()) return false;
+        auto &slot = shm::slots(m_header)[index];
+        uint64_t words[shm::record_words];
+        for (int attempt = 0; attempt < 1000; attempt++) {
+            uint64_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            for (size_t i = 0; i < shm::record_words; i++)
+                words[i] = slot.words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+            shm::unpack(words, out);
+            return true;
+        }
+        return false;
+    }
+};
+}; // namespace signal
+
+#endif /* Header guard */
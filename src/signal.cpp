@@ -26,8 +26,31 @@ typedef struct signal_manager_s {
 
 typedef struct signal_parameters_s {
     signal::parameters param;
+    bool owned = true;
+
+    signal_parameters_s() = default;
+    signal_parameters_s(void *buf, size_t size)
+        : param(buf, size), owned(false)
+    {
+    }
 } signal_parameters_t;
 
+struct c_function_data {
+    signal_function_data_t fun;
+    void *data;
+
+    void operator()(const signal::parameters &p, signal::parameters *r) const
+    {
+        fun(reinterpret_cast<const signal_parameters_t *>(&p),
+            reinterpret_cast<signal_parameters_t *>(r), data);
+    }
+
+    bool operator==(const c_function_data &o) const
+    {
+        return fun == o.fun && data == o.data;
+    }
+};
+
 signal_manager_t *signal_manager_create(void)
 {
     auto *m = new signal_manager_t;
@@ -43,13 +66,46 @@ signal_parameters_t *signal_parameters_create(void)
     return sp;
 }
 
-void signal_parameters_free(signal_parameters_t *p) { delete p; }
+void signal_parameters_free(signal_parameters_t *p)
+{
+    if (p && !p->owned)
+        p->~signal_parameters_t();
+    else
+        delete p;
+}
+
+signal_parameters_t *signal_parameters_init(void *buf, size_t size)
+{
+    if (!buf) return nullptr;
+    auto begin = reinterpret_cast<uintptr_t>(buf);
+    auto align = alignof(signal_parameters_t);
+    auto offset = ((begin + align - 1) & ~(align - 1)) - begin;
+    if (size < offset + sizeof(signal_parameters_t)) return nullptr;
+
+    auto *mem = static_cast<char *>(buf) + offset;
+    size -= offset + sizeof(signal_parameters_t);
+    return new (mem)
+        signal_parameters_t(mem + sizeof(signal_parameters_t), size);
+}
+
+size_t signal_parameters_storage_size(size_t count, size_t bytes)
+{
+    return alignof(signal_parameters_t) + sizeof(signal_parameters_t) +
+           signal::parameters::storage_size(count, bytes);
+}
+
+void signal_parameters_reset(signal_parameters_t *p)
+{
+    if (p) p->param.reset();
+}
 
 bool signal_send(signal_manager_t *m, const char *id,
                  const signal_parameters_t *param, signal_parameters_t *out)
 {
     if (!m || !id) return false;
-    return m->man.send(id, param->param, &out->param);
+    auto *response = out ? &out->param : nullptr;
+    if (param) return m->man.send(id, param->param, response);
+    return m->man.send(id, signal::parameters(), response);
 }
 
 bool signal_add(signal_manager_t *m, const char *id, signal_function_t fun)
@@ -58,6 +114,56 @@ bool signal_add(signal_manager_t *m, const char *id, signal_function_t fun)
     return m->man.add(id, reinterpret_cast<signal::signal_function>(fun));
 }
 
+bool signal_add_with_data(signal_manager_t *m, const char *id,
+                          signal_function_data_t fun, void *data)
+{
+    if (!m || !fun || !id) return false;
+    return m->man.add(id, c_function_data{fun, data});
+}
+
+bool signal_post(signal_manager_t *m, const char *id,
+                 const signal_parameters_t *param)
+{
+    if (!m || !id) return false;
+    if (param)
+        return m->man.post(id, signal::shared_parameters(param->param));
+    return m->man.post(id);
+}
+
+int signal_manager_get_fd(signal_manager_t *m)
+{
+    if (!m) return -1;
+    return m->man.fd();
+}
+
+size_t signal_process_ready(signal_manager_t *m, size_t max_items)
+{
+    if (!m) return 0;
+    return m->man.process_ready(max_items);
+}
+
+bool signal_set_groups(signal_manager_t *m, const char *id, uint64_t groups)
+{
+    if (!m || !id) return false;
+    return m->man.set_groups(id, groups);
+}
+
+void signal_mute(signal_manager_t *m, uint64_t groups)
+{
+    if (m) m->man.mute(groups);
+}
+
+void signal_unmute(signal_manager_t *m, uint64_t groups)
+{
+    if (m) m->man.unmute(groups);
+}
+
+uint64_t signal_get_muted_count(signal_manager_t *m, const char *id)
+{
+    if (!m || !id) return 0;
+    return m->man.stats(id).muted;
+}
+
 bool signal_parameters_set_int(signal_parameters_t *p, const char *id, int val)
 {
     if (!p || !id) return false;
@@ -95,7 +201,7 @@ bool signal_parameters_set_double(signal_parameters_t *p, const char *id,
 bool signal_parameters_set_string(signal_parameters_t *p, const char *id,
                                   const char *val)
 {
-    if (!p || !id) return false;
+    if (!p || !id || !val) return false;
     return p->param.add<std::string>(id, std::string(val));
 }
 
@@ -103,11 +209,67 @@ bool signal_parameters_set_data(signal_parameters_t *p, const char *id,
                                 void *val, size_t size)
 {
     if (!p || !id || !val) return false;
-    void *d = malloc(size);
-    memcpy(d, &val, size);
     return p->param.add_direct(id, val, size);
 }
 
+size_t signal_parameters_set_many(signal_parameters_t *p,
+                                  const signal_parameter_t *params,
+                                  size_t count)
+{
+    if (!p || !params) return 0;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!params[i].id) continue;
+        bytes += strlen(params[i].id) + 1;
+        switch (params[i].type) {
+        case SIGNAL_PARAMETER_STRING:
+            bytes += sizeof(std::string);
+            break;
+        case SIGNAL_PARAMETER_DATA:
+            bytes += params[i].value.data.size;
+            break;
+        default:
+            bytes += sizeof(double);
+        }
+    }
+    p->param.reserve(signal::parameters::storage_size(
+        count, bytes, alignof(std::max_align_t)));
+
+    size_t added = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto &v = params[i].value;
+        const char *id = params[i].id;
+        bool ok = false;
+        switch (params[i].type) {
+        case SIGNAL_PARAMETER_INT:
+            ok = signal_parameters_set_int(p, id, v.i);
+            break;
+        case SIGNAL_PARAMETER_UINT:
+            ok = signal_parameters_set_uint(p, id, v.u);
+            break;
+        case SIGNAL_PARAMETER_BOOL:
+            ok = signal_parameters_set_bool(p, id, v.b);
+            break;
+        case SIGNAL_PARAMETER_FLOAT:
+            ok = signal_parameters_set_float(p, id, v.f);
+            break;
+        case SIGNAL_PARAMETER_DOUBLE:
+            ok = signal_parameters_set_double(p, id, v.d);
+            break;
+        case SIGNAL_PARAMETER_STRING:
+            ok = signal_parameters_set_string(p, id, v.s);
+            break;
+        case SIGNAL_PARAMETER_DATA:
+            ok = id && v.data.ptr &&
+                 p->param.add_direct(id, v.data.ptr, v.data.size);
+            break;
+        }
+        if (ok) ++added;
+    }
+    return added;
+}
+
 int signal_parameters_get_int(const signal_parameters_t *p, const char *id,
                               bool *ok)
 {
@@ -180,3 +342,63 @@ const void *signal_parameters_get_data(const signal_parameters_t *p,
     }
     return p->param.get_direct(id, ok);
 }
+
+template <class T>
+static bool set_array(signal_parameters_t *p, const char *id, const T *val,
+                      size_t count)
+{
+    if (!p || !id || (!val && count)) return false;
+    return p->param.add_array<T>(id, val, count);
+}
+
+template <class T>
+static const T *get_array(const signal_parameters_t *p, const char *id,
+                          size_t *count)
+{
+    if (count) *count = 0;
+    if (!p || !id) return nullptr;
+
+    bool ok = false;
+    auto arr = p->param.get_array<T>(id, &ok);
+    if (!ok) return nullptr;
+    if (count) *count = arr.size;
+    return arr.data;
+}
+
+bool signal_parameters_set_float_array(signal_parameters_t *p, const char *id,
+                                       const float *val, size_t count)
+{
+    return set_array(p, id, val, count);
+}
+
+bool signal_parameters_set_double_array(signal_parameters_t *p,
+                                        const char *id, const double *val,
+                                        size_t count)
+{
+    return set_array(p, id, val, count);
+}
+
+bool signal_parameters_set_int_array(signal_parameters_t *p, const char *id,
+                                     const int *val, size_t count)
+{
+    return set_array(p, id, val, count);
+}
+
+const float *signal_parameters_get_float_array(const signal_parameters_t *p,
+                                               const char *id, size_t *count)
+{
+    return get_array<float>(p, id, count);
+}
+
+const double *signal_parameters_get_double_array(const signal_parameters_t *p,
+                                                 const char *id,
+                                                 size_t *count)
+{
+    return get_array<double>(p, id, count);
+}
+
+const int *signal_parameters_get_int_array(const signal_parameters_t *p,
+                                           const char *id, size_t *count)
+{
+    return get_array<int>(p, id, count);
+}
@@ -0,0 +1,206 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Compile time signal ids and a manager for a fixed set of signals. Ids are
+ * FNV-1a hashes of the signal name, created with the _sig literal or the
+ * SIGNAL_ID macro. A static_manager stores one receiver list per id in a
+ * fixed array, so sending to an id known at compile time is an indexed load
+ * followed by the receiver loop */
+
+#ifndef LIB_SIGNAL_STATIC_MANAGER_H
+#define LIB_SIGNAL_STATIC_MANAGER_H
+
+#include "libsignal.h"
+#include <array>
+
+namespace signal
+{
+/**
+ * \brief Compile time id of a signal
+ * \defgroup signal++
+ */
+enum class signal_id : uint64_t {};
+
+/**
+ * \brief Create a signal id from a signal name
+ * \defgroup signal++
+ */
+constexpr signal_id make_id(std::string_view name)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : name)
+        h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    return signal_id(h);
+}
+
+/**
+ * \brief Check a list of signal names for duplicates and hash collisions,
+ * e.g. static_assert(!signal::id_collision("a", "b"))
+ * \return true if two names are equal or have the same id
+ * \defgroup signal++
+ */
+template <class... Names> constexpr bool id_collision(const Names &... names)
+{
+    const std::array<std::string_view, sizeof...(Names)> list = {
+        std::string_view(names)...};
+    for (size_t i = 0; i < sizeof...(Names); ++i) {
+        for (size_t j = i + 1; j < sizeof...(Names); ++j) {
+            if (make_id(list[i]) == make_id(list[j])) return true;
+        }
+    }
+    return false;
+}
+
+namespace literals
+{
+constexpr signal_id operator""_sig(const char *name, size_t len)
+{
+    return make_id(std::string_view(name, len));
+}
+}; // namespace literals
+
+#define SIGNAL_ID(name) (::signal::make_id(name))
+
+/**
+ * \brief Manager for a set of signals known at compile time, e.g.
+ * static_manager<"input.key"_sig, "scene.changed"_sig>. Listing an id twice
+ * is a compile error
+ * \class static_manager
+ * \defgroup signal++
+ */
+template <signal_id... Ids> class static_manager
+{
+    static constexpr size_t count = sizeof...(Ids);
+    static constexpr signal_id ids[count] = {Ids...};
+
+    static constexpr bool unique()
+    {
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = i + 1; j < count; ++j) {
+                if (ids[i] == ids[j]) return false;
+            }
+        }
+        return true;
+    }
+    static_assert(count > 0, "A static_manager needs at least one signal");
+    static_assert(unique(), "Duplicate or colliding signal id");
+
+    /* Ids sorted for the runtime lookup, paired with their index */
+    struct slot {
+        signal_id id;
+        size_t index;
+    };
+
+    static constexpr std::array<slot, count> sorted()
+    {
+        std::array<slot, count> s{};
+        for (size_t i = 0; i < count; ++i) {
+            size_t j = i;
+            for (; j > 0 && s[j - 1].id > ids[i]; --j)
+                s[j] = s[j - 1];
+            s[j] = {ids[i], i};
+        }
+        return s;
+    }
+    static constexpr std::array<slot, count> m_lookup = sorted();
+
+    std::array<std::vector<delegate>, count> m_receivers;
+
+    static const slot *find(signal_id id)
+    {
+        auto it = std::lower_bound(
+            m_lookup.begin(), m_lookup.end(), id,
+            [](const slot &s, signal_id i) { return s.id < i; });
+        if (it == m_lookup.end() || it->id != id) return nullptr;
+        return &*it;
+    }
+
+  public:
+    /**
+     * \return the index of Id in the receiver table
+     * \defgroup signal++
+     */
+    template <signal_id Id> static constexpr size_t index()
+    {
+        size_t i = 0;
+        while (i < count && ids[i] != Id)
+            ++i;
+        return i;
+    }
+
+    /**
+     * \brief Add a receiver to a signal
+     * \param d the receiver
+     * \return true if the receiver could be added, false if it is empty or
+     * already registered \defgroup signal++
+     */
+    template <signal_id Id> bool add(delegate d)
+    {
+        static_assert(index<Id>() < count, "Unknown signal id");
+        auto &list = m_receivers[index<Id>()];
+        if (!d || std::find(list.begin(), list.end(), d) != list.end())
+            return false;
+        list.emplace_back(std::move(d));
+        return true;
+    }
+
+    /**
+     * \brief Send a signal which is known at compile time
+     * \param param the parameters to send to the receivers
+     * \param response the response parameters used by the receivers
+     * \defgroup signal++
+     */
+    template <signal_id Id>
+    void send(const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        static_assert(index<Id>() < count, "Unknown signal id");
+        for (const auto &recv : m_receivers[index<Id>()])
+            recv(param, response);
+    }
+
+    /**
+     * \brief Send a signal with an id only known at runtime
+     * \return true if the id belongs to this manager
+     * \defgroup signal++
+     */
+    bool send(signal_id id, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        auto s = find(id);
+        if (!s) return false;
+        for (const auto &recv : m_receivers[s->index])
+            recv(param, response);
+        return true;
+    }
+
+    /**
+     * \brief Send a signal by name
+     * \return true if the name belongs to a signal of this manager
+     * \defgroup signal++
+     */
+    bool send(std::string_view name, const parameters &param = parameters(),
+              parameters *response = nullptr) const
+    {
+        return send(make_id(name), param, response);
+    }
+};
+}; // namespace signal
+
+#endif /* Header guard */
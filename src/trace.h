@@ -0,0 +1,369 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Dispatch tracing, libsignal.h records a span for every send and every
+ * receiver call if LIBSIGNAL_TRACE is defined. Spans are written to per
+ * thread ring buffers and can be exported as Chrome trace event JSON, which
+ * can be opened in chrome://tracing or ui.perfetto.dev */
+
+#ifndef LIB_SIGNAL_TRACE_H
+#define LIB_SIGNAL_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace signal
+{
+namespace trace
+{
+enum class kind : uint32_t { send, receiver };
+
+/**
+ * \brief One recorded span, timestamps are in nanoseconds
+ * \struct span
+ * \defgroup signal++
+ */
+struct span {
+    uint64_t begin;
+    uint64_t end;
+    const char *name;
+    kind type;
+    uint32_t receiver;
+};
+
+/**
+ * \brief Ring buffer of spans, only written by its own thread
+ * \class thread_buffer
+ * \defgroup signal++
+ */
+class thread_buffer
+{
+  public:
+    static constexpr size_t capacity = 1 << 16;
+
+  private:
+    /* A span guarded by a sequence lock, seq is odd while the owning
+     * thread writes it and 2 * (index + 1) once the span at index is
+     * complete. Readers copy the fields and check seq again, so dumping
+     * while spans are recorded doesn't race */
+    struct slot {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> begin{0}, end{0}, info{0};
+        std::atomic<const char *> name{nullptr};
+    };
+
+    std::unique_ptr<slot[]> m_slots{new slot[capacity]};
+    std::atomic<uint64_t> m_head{0};
+    uint32_t m_tid;
+
+  public:
+    explicit thread_buffer(uint32_t tid) : m_tid(tid) {}
+
+    uint32_t tid() const { return m_tid; }
+
+    void push(const span &s)
+    {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        auto head = m_head.load(relaxed);
+        auto &slot = m_slots[head & (capacity - 1)];
+        slot.seq.store(2 * head + 1, relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.begin.store(s.begin, relaxed);
+        slot.end.store(s.end, relaxed);
+        slot.info.store(uint64_t(s.type) << 32 | s.receiver, relaxed);
+        slot.name.store(s.name, relaxed);
+        slot.seq.store(2 * head + 2, std::memory_order_release);
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * \brief Copy the spans which are currently in the buffer, spans which
+     * are overwritten while copying are dropped
+     * \defgroup signal++
+     */
+    std::vector<span> snapshot() const
+    {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        auto head = m_head.load(std::memory_order_acquire);
+        auto first = head > capacity ? head - capacity : 0;
+        std::vector<span> out;
+        out.reserve(head - first);
+        for (auto i = first; i < head; ++i) {
+            const auto &slot = m_slots[i & (capacity - 1)];
+            auto seq = slot.seq.load(std::memory_order_acquire);
+            span s;
+            s.begin = slot.begin.load(relaxed);
+            s.end = slot.end.load(relaxed);
+            auto info = slot.info.load(relaxed);
+            s.name = slot.name.load(relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq != 2 * i + 2 || slot.seq.load(relaxed) != seq) continue;
+            s.type = kind(info >> 32);
+            s.receiver = uint32_t(info);
+            out.push_back(s);
+        }
+        return out;
+    }
+};
+
+/**
+ * \brief Global trace state, holds the buffers of all running threads
+ * which recorded spans and the names of all traced signals. The buffer of
+ * a thread is freed when it exits, its newest spans are kept until the
+ * next dump
+ * \class tracer
+ * \defgroup signal++
+ */
+class tracer
+{
+    struct retired_span {
+        uint32_t tid;
+        span s;
+    };
+
+    /* Owns the buffer of a thread and retires it when the thread exits */
+    struct thread_slot {
+        std::shared_ptr<thread_buffer> buffer;
+        ~thread_slot()
+        {
+            if (buffer) tracer::get().retire(buffer);
+        }
+    };
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<thread_buffer>> m_buffers;
+    std::vector<retired_span> m_retired;
+    size_t m_retired_head = 0;
+    uint32_t m_next_tid = 1;
+    std::set<std::string, std::less<>> m_names;
+    std::string m_exit_path;
+    std::atomic<bool> m_enabled{true};
+    const std::chrono::steady_clock::time_point m_start =
+        std::chrono::steady_clock::now();
+
+    static void write_escaped(std::ostream &out, const char *str)
+    {
+        for (; str && *str; ++str) {
+            char c = *str;
+            if (c == '"' || c == '\\')
+                out << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                out << ' ';
+            else
+                out << c;
+        }
+    }
+
+  public:
+    static tracer &get()
+    {
+        static tracer instance;
+        return instance;
+    }
+
+    bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * \brief Turn recording on or off at runtime, tracing is enabled by
+     * default
+     * \defgroup signal++
+     */
+    void enable(bool e) { m_enabled.store(e, std::memory_order_relaxed); }
+
+    /**
+     * \return nanoseconds since the tracer was created
+     * \defgroup signal++
+     */
+    uint64_t now() const
+    {
+        return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now() - m_start)
+                            .count());
+    }
+
+    /**
+     * \brief Store a name for the lifetime of the tracer, so spans can keep
+     * a pointer to it
+     * \defgroup signal++
+     */
+    const char *intern(std::string_view name)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_names.find(name);
+        if (it == m_names.end()) it = m_names.emplace(name).first;
+        return it->c_str();
+    }
+
+    /**
+     * \return the buffer of the calling thread, it is created on first use
+     * \defgroup signal++
+     */
+    thread_buffer &buffer()
+    {
+        static thread_local thread_slot local;
+        if (!local.buffer) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            local.buffer = std::make_shared<thread_buffer>(m_next_tid++);
+            m_buffers.push_back(local.buffer);
+        }
+        return *local.buffer;
+    }
+
+    /**
+     * \brief Move the spans of a thread which exits out of its buffer and
+     * free it. At most thread_buffer::capacity spans of exited threads are
+     * kept, older ones are replaced first
+     * \defgroup signal++
+     */
+    void retire(const std::shared_ptr<thread_buffer> &buffer)
+    {
+        auto spans = buffer->snapshot();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffers.erase(
+            std::remove(m_buffers.begin(), m_buffers.end(), buffer),
+            m_buffers.end());
+        for (const auto &s : spans) {
+            if (m_retired.size() < thread_buffer::capacity) {
+                m_retired.push_back({buffer->tid(), s});
+                continue;
+            }
+            m_retired[m_retired_head] = {buffer->tid(), s};
+            m_retired_head = (m_retired_head + 1) % m_retired.size();
+        }
+    }
+
+    void record(const char *name, kind type, uint64_t begin, uint64_t end,
+                uint32_t receiver = 0)
+    {
+        buffer().push({begin, end, name, type, receiver});
+    }
+
+    /**
+     * \brief Write all recorded spans as Chrome trace event JSON
+     * \defgroup signal++
+     */
+    void dump(std::ostream &out)
+    {
+        std::vector<std::shared_ptr<thread_buffer>> buffers;
+        std::vector<retired_span> retired;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            buffers = m_buffers;
+            retired = m_retired;
+        }
+
+        char num[64];
+        bool first = true;
+        auto write = [&](uint32_t tid, const span &s) {
+            out << (first ? "\n" : ",\n") << "{\"name\":\"";
+            write_escaped(out, s.name);
+            if (s.type == kind::receiver) out << " #" << s.receiver;
+            snprintf(num, sizeof(num), "\"ts\":%.3f,\"dur\":%.3f",
+                     s.begin / 1000.0, (s.end - s.begin) / 1000.0);
+            out << "\",\"cat\":\""
+                << (s.type == kind::send ? "send" : "receiver")
+                << "\",\"ph\":\"X\"," << num << ",\"pid\":1,\"tid\":" << tid
+                << "}";
+            first = false;
+        };
+
+        out << "{\"traceEvents\":[";
+        for (const auto &r : retired)
+            write(r.tid, r.s);
+        for (const auto &buf : buffers) {
+            for (const auto &s : buf->snapshot())
+                write(buf->tid(), s);
+        }
+        out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    /**
+     * \brief Write all recorded spans as Chrome trace event JSON to a file
+     * \return true if the file could be written
+     * \defgroup signal++
+     */
+    bool dump(const char *path)
+    {
+        std::ofstream out(path);
+        if (!out) return false;
+        dump(out);
+        return bool(out);
+    }
+
+    /**
+     * \brief Write the trace to path when the program exits
+     * \defgroup signal++
+     */
+    void dump_at_exit(const char *path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool registered = !m_exit_path.empty();
+            m_exit_path = path;
+            if (registered) return;
+        }
+        std::atexit([] {
+            auto &t = tracer::get();
+            t.dump(t.m_exit_path.c_str());
+        });
+    }
+};
+
+/**
+ * \brief Records a span from construction to destruction if tracing is
+ * enabled
+ * \class scope
+ * \defgroup signal++
+ */
+class scope
+{
+    const char *m_name;
+    kind m_type;
+    bool m_active;
+    uint64_t m_begin = 0;
+
+  public:
+    scope(const char *name, kind type)
+        : m_name(name), m_type(type), m_active(tracer::get().enabled())
+    {
+        if (m_active) m_begin = tracer::get().now();
+    }
+
+    ~scope()
+    {
+        auto &t = tracer::get();
+        if (m_active) t.record(m_name, m_type, m_begin, t.now());
+    }
+};
+}; // namespace trace
+}; // namespace signal
+
+#endif /* Header guard */
@@ -17,13 +17,63 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
+#include <alloc_hooks.h>
+
 extern int signal_cpp_test();
 extern int signal_c_test();
+extern int signal_delegate_test();
+extern int signal_parameters_test();
+extern int signal_alloc_test();
+extern int signal_trace_test();
+extern int signal_filter_test();
+extern int signal_shared_test();
+extern int signal_array_test();
+extern int signal_static_test();
+extern int signal_lazy_test();
+extern int signal_policy_test();
+extern int signal_freeze_test();
+extern int signal_sticky_test();
+extern int signal_timer_test();
+extern int signal_connect_test();
+extern int signal_post_test();
+extern int signal_realtime_test();
+extern int signal_ring_test();
+extern int signal_sharded_test();
+extern int signal_distinct_test();
+extern int signal_counters_test();
+extern int signal_memoize_test();
+extern int signal_aggregate_test();
+extern int signal_groups_test();
+extern int signal_schedule_test();
 
 int main()
 {
     int err = 0;
     err += signal_cpp_test();
     err += signal_c_test();
+    err += signal_delegate_test();
+    err += signal_parameters_test();
+    err += signal_alloc_test();
+    err += signal_trace_test();
+    err += signal_filter_test();
+    err += signal_shared_test();
+    err += signal_array_test();
+    err += signal_static_test();
+    err += signal_lazy_test();
+    err += signal_policy_test();
+    err += signal_freeze_test();
+    err += signal_sticky_test();
+    err += signal_timer_test();
+    err += signal_connect_test();
+    err += signal_post_test();
+    err += signal_realtime_test();
+    err += signal_ring_test();
+    err += signal_sharded_test();
+    err += signal_distinct_test();
+    err += signal_counters_test();
+    err += signal_memoize_test();
+    err += signal_aggregate_test();
+    err += signal_groups_test();
+    err += signal_schedule_test();
     return err;
 }
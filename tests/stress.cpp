@@ -0,0 +1,419 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Multithreaded stress test, every combination of the given scenario
+ * values runs for a fixed duration and prints one CSV row per thread
+ * count:
+ *
+ *   signal_stress --mode locked --threads 1,2,4,8 --signals 1000
+ *                 --receivers 1,16 --payload 64 --add-ratio 0,0.001
+ *                 --duration 2 --csv result.csv
+ *
+ * Modes:
+ *   locked: one manager behind a std::shared_mutex, sends take a shared
+ *           lock and adds an exclusive lock
+ *   frozen: a frozen manager which is only sent to, requires an add
+ *           ratio of 0
+ *   sharded: a sharded_manager, adds lock one of its shards
+ *
+ * The add ratio is the share of operations which change a receiver list
+ * instead of sending. Each thread adds its own receivers to the signals
+ * which are sent and removes them again, so sends race with lists that
+ * are being changed.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <libsignal.h>
+#include <sharded_manager.h>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+struct scenario {
+    size_t threads, signals, receivers, payload;
+    double add_ratio;
+};
+
+struct result {
+    uint64_t ops;
+    double throughput, p50, p99, p999;
+};
+
+/* Latency histogram with 16 linear steps per power of two, the error of
+ * a percentile is at most 1/16 */
+class histogram
+{
+    static constexpr int sub_bits = 4;
+    uint64_t m_counts[64 << sub_bits] = {};
+
+    static size_t bucket(uint64_t ns)
+    {
+        if (ns < (1u << sub_bits)) return size_t(ns);
+        int msb = sub_bits;
+        while (ns >> (msb + 1))
+            msb++;
+        int shift = msb - sub_bits;
+        return size_t(((shift + 1) << sub_bits) +
+                      ((ns >> shift) & ((1u << sub_bits) - 1)));
+    }
+
+    static uint64_t lower_bound(size_t index)
+    {
+        if (index < (1u << sub_bits)) return index;
+        int shift = int(index >> sub_bits) - 1;
+        return (uint64_t((1u << sub_bits) +
+                         (index & ((1u << sub_bits) - 1))))
+               << shift;
+    }
+
+  public:
+    void add(uint64_t ns) { m_counts[bucket(ns)]++; }
+
+    void merge(const histogram &o)
+    {
+        for (size_t i = 0; i < sizeof(m_counts) / sizeof(*m_counts); i++)
+            m_counts[i] += o.m_counts[i];
+    }
+
+    uint64_t count() const
+    {
+        uint64_t n = 0;
+        for (auto c : m_counts)
+            n += c;
+        return n;
+    }
+
+    double percentile(double p) const
+    {
+        uint64_t target = uint64_t(p * double(count()));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < sizeof(m_counts) / sizeof(*m_counts); i++) {
+            seen += m_counts[i];
+            if (seen > target) return double(lower_bound(i));
+        }
+        return 0;
+    }
+};
+
+/* Every mode has to provide send(), add() and remove() which are safe to
+ * call from any thread */
+class locked_mode
+{
+    signal::manager m_manager;
+    mutable shared_mutex m_lock;
+
+  public:
+    bool send(const string &id, const signal::parameters &p) const
+    {
+        shared_lock<shared_mutex> lock(m_lock);
+        return m_manager.send(id, p);
+    }
+
+    bool add(const string &id, signal::delegate d)
+    {
+        unique_lock<shared_mutex> lock(m_lock);
+        return m_manager.add(id, std::move(d));
+    }
+
+    bool remove(const string &id, const signal::delegate &d)
+    {
+        unique_lock<shared_mutex> lock(m_lock);
+        return m_manager.remove(id, d);
+    }
+
+    void ready() {}
+};
+
+class frozen_mode
+{
+    signal::manager m_manager;
+
+  public:
+    bool send(const string &id, const signal::parameters &p) const
+    {
+        return m_manager.send(id, p);
+    }
+
+    bool add(const string &id, signal::delegate d)
+    {
+        return m_manager.add(id, std::move(d));
+    }
+
+    bool remove(const string &id, const signal::delegate &d)
+    {
+        return m_manager.remove(id, d);
+    }
+
+    void ready() { m_manager.freeze(); }
+};
+
+class sharded_mode
+{
+    signal::sharded_manager m_manager;
+
+  public:
+    bool send(const string &id, const signal::parameters &p) const
+    {
+        return m_manager.send(id, p);
+    }
+
+    bool add(const string &id, signal::delegate d)
+    {
+        return m_manager.add(id, std::move(d));
+    }
+
+    bool remove(const string &id, const signal::delegate &d)
+    {
+        return m_manager.remove(id, d);
+    }
+
+    void ready() {}
+};
+
+static thread_local uint64_t sink = 0;
+
+static void receive(const signal::parameters &in, signal::parameters *)
+{
+    size_t size = 0;
+    auto *data = static_cast<const uint8_t *>(in.get_direct("payload", size));
+    sink += size ? data[size - 1] : 1;
+}
+
+/* A receiver added while sending, it can be compared and removed again.
+ * Any thread may run it, so the calls are counted atomically */
+struct late_receiver {
+    atomic<uint64_t> *calls;
+    uint64_t tag;
+
+    void operator()(const signal::parameters &in,
+                    signal::parameters *out) const
+    {
+        calls->fetch_add(1, memory_order_relaxed);
+        receive(in, out);
+    }
+
+    bool operator==(const late_receiver &o) const
+    {
+        return calls == o.calls && tag == o.tag;
+    }
+};
+
+template <class M>
+static result run(const scenario &s, chrono::duration<double> duration)
+{
+    M m;
+    vector<string> ids;
+    for (size_t i = 0; i < s.signals; i++) {
+        ids.push_back("stress.signal." + to_string(i));
+        for (size_t r = 0; r < s.receivers; r++)
+            m.add(ids.back(), [r](const signal::parameters &in,
+                                  signal::parameters *out) {
+                sink += r;
+                receive(in, out);
+            });
+    }
+    m.ready();
+
+    atomic<bool> start{false}, stop{false};
+    vector<histogram> latency(s.threads);
+    vector<uint64_t> ops(s.threads);
+    vector<atomic<uint64_t>> calls(s.threads);
+    vector<thread> workers;
+    const uint64_t add_threshold = uint64_t(s.add_ratio * double(~0ull));
+
+    for (size_t t = 0; t < s.threads; t++) {
+        workers.emplace_back([&, t] {
+            vector<uint8_t> payload(s.payload, uint8_t(t));
+            signal::parameters p;
+            if (s.payload) p.add_direct("payload", payload.data(), s.payload);
+
+            uint64_t rng = 0x9e3779b97f4a7c15ull * (t + 1), n = 0, tag = 0;
+            auto &hist = latency[t];
+
+            /* Receivers this thread added, the oldest is removed once
+             * there are a few of them */
+            constexpr size_t outstanding = 8;
+            vector<pair<size_t, late_receiver>> added;
+            while (!start.load(memory_order_acquire))
+                this_thread::yield();
+
+            while (!stop.load(memory_order_relaxed)) {
+                rng ^= rng << 13;
+                rng ^= rng >> 7;
+                rng ^= rng << 17;
+                const string &id = ids[rng % ids.size()];
+
+                auto begin = chrono::steady_clock::now();
+                if (rng >= add_threshold) {
+                    m.send(id, p);
+                } else if (added.size() < outstanding) {
+                    added.push_back({rng % ids.size(), {&calls[t], tag++}});
+                    m.add(ids[added.back().first], added.back().second);
+                } else {
+                    m.remove(ids[added.front().first], added.front().second);
+                    added.erase(added.begin());
+                }
+                auto end = chrono::steady_clock::now();
+                hist.add(uint64_t(
+                    chrono::duration_cast<chrono::nanoseconds>(end - begin)
+                        .count()));
+                n++;
+            }
+            ops[t] = n;
+        });
+    }
+
+    auto begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    this_thread::sleep_for(duration);
+    stop.store(true);
+    for (auto &w : workers)
+        w.join();
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - begin;
+
+    histogram all;
+    result r{};
+    for (size_t t = 0; t < s.threads; t++) {
+        all.merge(latency[t]);
+        r.ops += ops[t];
+    }
+    r.throughput = double(r.ops) / elapsed.count();
+    r.p50 = all.percentile(0.5);
+    r.p99 = all.percentile(0.99);
+    r.p999 = all.percentile(0.999);
+    return r;
+}
+
+template <class T> static vector<T> parse_list(const char *arg)
+{
+    vector<T> list;
+    stringstream ss(arg);
+    string item;
+    while (getline(ss, item, ',')) {
+        T v{};
+        stringstream(item) >> v;
+        list.push_back(v);
+    }
+    return list;
+}
+
+static int usage()
+{
+    cerr << "Usage: signal_stress [--mode locked|frozen|sharded] "
+            "[--threads 1,2,4] "
+            "[--signals 1000] [--receivers 4] [--payload 64] "
+            "[--add-ratio 0.001] [--duration 1] [--csv file]"
+         << endl;
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    string mode = "locked", csv;
+    vector<size_t> threads = {1, 2, 4}, signals = {1000}, receivers = {4},
+                   payloads = {64};
+    vector<double> add_ratios = {0.001};
+    double duration = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) return usage();
+        const char *arg = argv[i], *val = argv[++i];
+        if (!strcmp(arg, "--mode"))
+            mode = val;
+        else if (!strcmp(arg, "--threads"))
+            threads = parse_list<size_t>(val);
+        else if (!strcmp(arg, "--signals"))
+            signals = parse_list<size_t>(val);
+        else if (!strcmp(arg, "--receivers"))
+            receivers = parse_list<size_t>(val);
+        else if (!strcmp(arg, "--payload"))
+            payloads = parse_list<size_t>(val);
+        else if (!strcmp(arg, "--add-ratio"))
+            add_ratios = parse_list<double>(val);
+        else if (!strcmp(arg, "--duration"))
+            duration = atof(val);
+        else if (!strcmp(arg, "--csv"))
+            csv = val;
+        else
+            return usage();
+    }
+
+    result (*runner)(const scenario &, chrono::duration<double>);
+    if (mode == "locked") {
+        runner = run<locked_mode>;
+    } else if (mode == "sharded") {
+        runner = run<sharded_mode>;
+    } else if (mode == "frozen") {
+        runner = run<frozen_mode>;
+        for (auto ratio : add_ratios) {
+            if (ratio > 0) {
+                cerr << "The frozen mode can't add receivers while sending, "
+                        "use --add-ratio 0"
+                     << endl;
+                return 1;
+            }
+        }
+    } else {
+        return usage();
+    }
+
+    ofstream file;
+    if (!csv.empty()) file.open(csv);
+    ostream &out = csv.empty() ? cout : file;
+    out << "mode,threads,signals,receivers,payload,add_ratio,ops,"
+           "ops_per_second,p50_ns,p99_ns,p999_ns,scaling_efficiency"
+        << endl;
+
+    for (auto sig : signals) {
+        for (auto recv : receivers) {
+            for (auto payload : payloads) {
+                for (auto ratio : add_ratios) {
+                    double base = 0;
+                    for (auto t : threads) {
+                        scenario s{t, sig, recv, payload, ratio};
+                        auto r =
+                            runner(s, chrono::duration<double>(duration));
+
+                        /* Throughput per thread relative to the first
+                         * thread count of this scenario */
+                        double per_thread = r.throughput / double(t);
+                        if (base == 0) base = per_thread;
+
+                        out << mode << ',' << t << ',' << sig << ',' << recv
+                            << ',' << payload << ',' << ratio << ','
+                            << r.ops << ',' << uint64_t(r.throughput) << ','
+                            << uint64_t(r.p50) << ',' << uint64_t(r.p99)
+                            << ',' << uint64_t(r.p999) << ','
+                            << (base > 0 ? per_thread / base : 0) << endl;
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
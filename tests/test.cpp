@@ -17,17 +17,61 @@
  * 3. This notice may not be removed or altered from any source distribution.
  */
 
+#include <aggregate.h>
 #include <assert.h>
 #include <cmath>
-#include <csignal.h>
 #include <cstdio>
 #include <iostream>
 #include <libsignal.h>
+#include <sstream>
+#include <realtime.h>
+#include <ring_buffer.h>
+#include <sharded_manager.h>
+#include <static_manager.h>
+#include <trace.h>
+
+#ifdef LINUX
+#include <poll.h>
+#include <shm_stats.h>
+#include <unistd.h>
+#endif
 
 #define FLOAT_LENIENCY 0.00001
 
+/* Fails if the following block allocates on this thread */
+#define expect_no_alloc                                                      \
+    for (no_alloc_check _check(__FILE__, __LINE__); _check.once();)
+
 using namespace std;
 
+class no_alloc_check
+{
+    size_t m_start = signal::alloc_stats::thread().allocations;
+    const char *m_file;
+    int m_line;
+    bool m_done = false;
+
+  public:
+    no_alloc_check(const char *file, int line) : m_file(file), m_line(line)
+    {
+    }
+
+    bool once()
+    {
+        bool first = !m_done;
+        m_done = true;
+        return first;
+    }
+
+    ~no_alloc_check()
+    {
+        size_t n = signal::alloc_stats::thread().allocations - m_start;
+        if (n)
+            cerr << m_file << ":" << m_line << ": " << n << " allocations\n";
+        assert(n == 0);
+    }
+};
+
 typedef struct point_s {
     int x, y;
 } point_t;
@@ -223,6 +267,1647 @@ void register_c_signals(signal_manager_t *man)
     assert(signal_add(man, "signal2", c_signal2));
 }
 
+class counter
+{
+  public:
+    int count = 0;
+    void on_signal(const signal::parameters &in, signal::parameters *)
+    {
+        count += in.get<int>("inc", nullptr, 1);
+    }
+};
+
+void c_signal_data(const signal_parameters_t *in, signal_parameters_t *,
+                   void *data)
+{
+    auto *count = reinterpret_cast<int *>(data);
+    *count += signal_parameters_get_int(in, "inc", NULL);
+}
+
+int signal_delegate_test()
+{
+    cout << "---- Delegate Test ----" << endl;
+
+    signal::manager m;
+    signal::parameters in;
+    counter c;
+    int lambda_count = 0, c_count = 0;
+    assert(in.add<int>("inc", 2));
+
+    assert(m.add("lambda", [&lambda_count](const signal::parameters &p,
+                                           signal::parameters *) {
+        lambda_count += p.get<int>("inc");
+    }));
+    assert(m.add("member", &c, &counter::on_signal));
+    assert(!m.add("member", &c, &counter::on_signal));
+    assert(m.add("member", cpp_signal2));
+    assert(!m.add("member", cpp_signal2));
+
+    auto obj = std::make_shared<receiver_b>();
+    assert(m.add("object", obj));
+    assert(!m.add("object", obj));
+
+    assert(m.send("lambda", in));
+    assert(m.send("member", in));
+    assert(m.send("lambda", in));
+    assert(lambda_count == 4);
+    assert(c.count == 2);
+
+    /* Big captures fall back to the heap but behave the same */
+    struct big {
+        double a, b, c, d;
+    } payload = {1, 2, 3, 4};
+    double sum = 0;
+    signal::delegate d = [payload, &sum](const signal::parameters &,
+                                         signal::parameters *) {
+        sum += payload.a + payload.b + payload.c + payload.d;
+    };
+    signal::delegate copy(d);
+    assert(m.add("big", std::move(d)));
+    assert(!d);
+    assert(m.send("big"));
+    copy(in, nullptr);
+    assert(sum == 20);
+
+    signal_manager_t *cm = signal_manager_create();
+    signal_parameters_t *cin = signal_parameters_create();
+    assert(signal_parameters_set_int(cin, "inc", 3));
+    assert(signal_add_with_data(cm, "data", c_signal_data, &c_count));
+    assert(!signal_add_with_data(cm, "data", c_signal_data, &c_count));
+    assert(signal_add_with_data(cm, "data", c_signal_data, &lambda_count));
+    assert(signal_send(cm, "data", cin, nullptr));
+    assert(c_count == 3 && lambda_count == 7);
+    signal_parameters_free(cin);
+    signal_manager_free(cm);
+    return 0;
+}
+
+int signal_parameters_test()
+{
+    cout << "---- Parameters Test ----" << endl;
+
+    /* Copies own their values, long strings must survive growing */
+    signal::parameters a;
+    string long_str(100, 'x');
+    assert(a.add<string>("string", long_str));
+    for (int i = 0; i < 64; ++i)
+        assert(a.add<int>("int" + to_string(i), i));
+    assert(!a.add<int>("int0", 1));
+
+    signal::parameters b(a), c;
+    c = a;
+    a.reset();
+    assert(a.empty() && a.get<int>("int3", nullptr, -1) == -1);
+    assert(b.size() == 65 && c.size() == 65);
+    assert(b.get<string>("string") == long_str);
+    assert(c.get<int>("int63") == 63);
+
+    signal::parameters moved(std::move(b));
+    assert(moved.get<string>("string") == long_str && b.empty());
+
+    /* Stack storage, spills to the heap once it is full */
+    alignas(16) char buf[256];
+    signal::parameters stack(buf, sizeof(buf));
+    assert(stack.add<int>("a", 1));
+    assert(stack.get_direct("a") >= static_cast<void *>(buf) &&
+           stack.get_direct("a") < static_cast<void *>(buf + sizeof(buf)));
+    for (int i = 0; i < 32; ++i)
+        assert(stack.add<double>("d" + to_string(i), i));
+    assert(stack.get<int>("a") == 1 && stack.get<double>("d31") == 31);
+
+    /* Moving into a fixed buffer copies and fails cleanly */
+    alignas(16) char small[signal::parameters::storage_size(1, 16)];
+    signal::parameters fixed(small, sizeof(small), true);
+    signal::parameters one;
+    one.add<int>("a", 1);
+    fixed = std::move(one);
+    assert(fixed.get<int>("a") == 1);
+    fixed = std::move(stack);
+    assert(fixed.empty() && stack.get<double>("d31") == 31);
+
+    /* C API */
+    char cbuf[512];
+    size_t need = signal_parameters_storage_size(3, 64);
+    assert(need <= sizeof(cbuf));
+    assert(!signal_parameters_init(cbuf, 8));
+    signal_parameters_t *p = signal_parameters_init(cbuf + 1, need);
+    assert(p);
+
+    point_t pt = {2, 3};
+    signal_parameter_t desc[3];
+    desc[0].id = "int";
+    desc[0].type = SIGNAL_PARAMETER_INT;
+    desc[0].value.i = -5;
+    desc[1].id = "string";
+    desc[1].type = SIGNAL_PARAMETER_STRING;
+    desc[1].value.s = "abc";
+    desc[2].id = "data";
+    desc[2].type = SIGNAL_PARAMETER_DATA;
+    desc[2].value.data.ptr = &pt;
+    desc[2].value.data.size = sizeof(pt);
+
+    for (int i = 0; i < 3; ++i) {
+        assert(signal_parameters_set_many(p, desc, 3) == 3);
+        assert(signal_parameters_get_int(p, "int", nullptr) == -5);
+        assert(strcmp(signal_parameters_get_string(p, "string", nullptr),
+                      "abc") == 0);
+        auto *d = reinterpret_cast<const point_t *>(
+            signal_parameters_get_data(p, "data", nullptr));
+        assert(d->x == 2 && d->y == 3);
+        assert(signal_parameters_set_many(p, desc, 3) == 0);
+        signal_parameters_reset(p);
+    }
+
+    signal_manager_t *m = signal_manager_create();
+    assert(signal_add(m, "signal2", c_signal2));
+    assert(signal_send(m, "signal2", nullptr, nullptr));
+    assert(signal_send(m, "signal2", p, nullptr));
+    signal_parameters_free(p);
+    signal_manager_free(m);
+    return 0;
+}
+
+void quiet_signal(const signal::parameters &in, signal::parameters *out)
+{
+    if (out) out->add<int>("sum", in.get<int>("a") + in.get<int>("b"));
+}
+
+int signal_alloc_test()
+{
+    cout << "---- Allocation Test ----" << endl;
+
+    auto &stats = signal::alloc_stats::thread();
+    size_t before = stats.allocations;
+    delete new int(1);
+    assert(stats.allocations == before + 1);
+
+    signal::manager m;
+    size_t empty = m.memory_usage();
+    for (int i = 0; i < 20000; ++i)
+        assert(m.add("signal.with.a.long.id." + to_string(i), quiet_signal));
+    assert(m.memory_usage() > empty + 20000 * (sizeof(signal::signal) +
+                                                sizeof(signal::delegate)));
+
+    signal::parameters in, out;
+    assert(in.memory_usage() == sizeof(in));
+    for (int i = 0; i < 2; ++i) {
+        in.reset();
+        out.reset();
+        assert(in.add<int>("a", i) && in.add<int>("b", 2));
+        assert(m.send("signal.with.a.long.id.42", in, &out));
+        assert(out.get<int>("sum") == i + 2);
+    }
+    assert(in.memory_usage() > sizeof(in));
+
+    size_t sends = stats.send_allocations;
+    expect_no_alloc
+    {
+        in.reset();
+        out.reset();
+        assert(in.add<int>("a", 5) && in.add<int>("b", 2));
+        assert(m.send("signal.with.a.long.id.42", in, &out));
+        assert(!m.send("signal.with.a.long.id.does.not.exist", in, &out));
+        assert(out.get<int>("sum") == 7);
+    }
+    assert(stats.send_allocations == sends);
+
+    /* C plugin path, everything lives on the stack */
+    signal_manager_t *cm = signal_manager_create();
+    assert(signal_add(cm, "signal2", c_signal2));
+    expect_no_alloc
+    {
+        char buf[256];
+        signal_parameters_t *p = signal_parameters_init(buf, sizeof(buf));
+        signal_parameter_t desc[2];
+        desc[0].id = "x";
+        desc[0].type = SIGNAL_PARAMETER_FLOAT;
+        desc[0].value.f = 1.f;
+        desc[1].id = "str";
+        desc[1].type = SIGNAL_PARAMETER_STRING;
+        desc[1].value.s = "short";
+        assert(signal_parameters_set_many(p, desc, 2) == 2);
+        assert(signal_send(cm, "signal2", p, nullptr));
+        signal_parameters_free(p);
+    }
+    signal_manager_free(cm);
+    return 0;
+}
+
+int signal_trace_test()
+{
+    cout << "---- Trace Test ----" << endl;
+    auto &t = signal::trace::tracer::get();
+    const char *name = t.intern("manual \"span\"");
+    assert(name == t.intern("manual \"span\""));
+    t.record(name, signal::trace::kind::send, 1000, 3500);
+
+#ifdef LIBSIGNAL_TRACE
+    signal::manager m;
+    assert(m.add("traced.signal", cpp_signal2));
+    assert(m.add("traced.signal", quiet_signal));
+    assert(m.send("traced.signal"));
+#endif
+
+    stringstream json;
+    t.dump(json);
+    string str = json.str();
+    assert(str.find("{\"traceEvents\":[") == 0);
+    assert(str.find("\"name\":\"manual \\\"span\\\"\",\"cat\":\"send\","
+                    "\"ph\":\"X\",\"ts\":1.000,\"dur\":2.500") !=
+           string::npos);
+#ifdef LIBSIGNAL_TRACE
+    assert(str.find("\"name\":\"traced.signal\",\"cat\":\"send\"") !=
+           string::npos);
+    assert(str.find("\"name\":\"traced.signal #1\",\"cat\":\"receiver\"") !=
+           string::npos);
+#endif
+
+    /* Dumping while another thread records doesn't race, the spans of a
+     * thread which exited are kept after its buffer is freed */
+    const char *worker_name = t.intern("exited thread");
+    std::atomic<bool> recording{true};
+    std::thread worker([&] {
+        for (uint64_t i = 0; recording || i < 1000; i++)
+            t.record(worker_name, signal::trace::kind::send, i, i + 1);
+    });
+    for (int i = 0; i < 3; i++) {
+        stringstream during;
+        t.dump(during);
+    }
+    recording = false;
+    worker.join();
+    json.str("");
+    t.dump(json);
+    assert(json.str().find("\"name\":\"exited thread\"") != string::npos);
+    return 0;
+}
+
+int signal_filter_test()
+{
+    cout << "---- Filter Test ----" << endl;
+
+    signal::manager m;
+    int calls[100] = {}, unfiltered = 0;
+    for (int key = 0; key < 100; ++key) {
+        assert(m.add_filtered("input.key", "key", key,
+                              [&calls, key](const signal::parameters &p,
+                                            signal::parameters *) {
+                                  assert(p.get<int>("key") == key);
+                                  ++calls[key];
+                              }));
+    }
+    assert(m.add("input.key", [&unfiltered](const signal::parameters &,
+                                            signal::parameters *) {
+        ++unfiltered;
+    }));
+    assert(m.add_filtered("input.key", "key", 42, cpp_signal2));
+    assert(!m.add_filtered("input.key", "key", 42, cpp_signal2));
+    assert(m.add_filtered("input.key", "key", 43, cpp_signal2));
+
+    signal::parameters in;
+    assert(in.add<int>("key", 42));
+    assert(m.send("input.key", in));
+    assert(m.send("input.key"));
+    assert(unfiltered == 2 && calls[42] == 1);
+    for (int key = 0; key < 100; ++key)
+        assert(key == 42 || calls[key] == 0);
+
+    /* The type of the filter value has to match the parameter */
+    signal::parameters wrong;
+    assert(wrong.add<int64_t>("key", 42));
+    assert(m.send("input.key", wrong));
+    assert(calls[42] == 1);
+
+    bool flag_called = false;
+    assert(m.add_filtered("flag", "on", true,
+                          [&flag_called](const signal::parameters &,
+                                         signal::parameters *) {
+                              flag_called = true;
+                          }));
+    signal::parameters off;
+    assert(off.add<bool>("on", false));
+    assert(m.send("flag", off) && !flag_called);
+    return 0;
+}
+
+int signal_shared_test()
+{
+    cout << "---- Shared Parameters Test ----" << endl;
+
+    signal::parameters event;
+    char payload[2048] = {1, 2, 3};
+    assert(event.add_direct("payload", payload, sizeof(payload)));
+    assert(event.add<int>("int", 7));
+
+    signal::shared_parameters shared(std::move(event));
+    const void *data = shared->get_direct("payload");
+    std::vector<signal::shared_parameters> consumers;
+    consumers.reserve(8);
+    expect_no_alloc
+    {
+        for (int i = 0; i < 8; ++i)
+            consumers.push_back(shared);
+    }
+    assert(shared.use_count() == 9);
+    for (const auto &c : consumers)
+        assert(c->get_direct("payload") == data);
+
+    /* Shared parameters can be sent like any other parameters */
+    signal::manager m;
+    int sum = 0;
+    assert(m.add("shared", [&sum](const signal::parameters &p,
+                                  signal::parameters *) {
+        sum += p.get<int>("int");
+    }));
+    assert(m.send("shared", consumers[3]));
+    assert(sum == 7);
+
+    /* Copy on write */
+    assert(consumers[0].mutate().add<int>("extra", 1));
+    assert(consumers[0]->size() == 3 && shared->size() == 2);
+    assert(consumers[0]->get_direct("payload") != data);
+    assert(shared.use_count() == 8);
+
+    signal::shared_parameters single;
+    assert(single->empty() && single.use_count() == 0);
+    assert(single.mutate().add<int>("a", 1));
+    /* Not shared, so there is nothing to copy */
+    {
+        const signal::parameters *before = &single.get();
+        assert(single.mutate().add<int>("b", 2));
+        assert(&single.get() == before);
+    }
+    return 0;
+}
+
+float sum_levels(const signal::parameters &in)
+{
+    auto levels = in.get_array<float>("levels");
+    assert(reinterpret_cast<uintptr_t>(levels.data) %
+               signal::parameters::array_align ==
+           0);
+
+    float sum = 0;
+    for (float level : levels)
+        sum += level;
+    return sum;
+}
+
+int signal_array_test()
+{
+    cout << "---- Array Test ----" << endl;
+
+    float levels[1000];
+    for (int i = 0; i < 1000; ++i)
+        levels[i] = 0.5f;
+
+    signal::parameters in;
+    assert(in.add<char>("c", 'c'));
+    assert(in.add_array("levels", levels, 1000));
+    assert(!in.add_array("levels", levels, 1));
+    assert(in.get_array<float>("levels").size == 1000);
+    assert(sum_levels(in) == 500);
+
+    bool ok = true;
+    assert(in.get_array<double>("levels", &ok).empty() && !ok);
+    assert(in.get_array<char>("c", &ok).empty() && !ok);
+
+    /* Copies and regrown buffers keep the alignment */
+    signal::parameters copy(in);
+    assert(sum_levels(copy) == 500);
+    char buf[128];
+    signal::parameters stack(buf + 3, sizeof(buf) - 3);
+    assert(stack.add<char>("c", 'c'));
+    assert(stack.add_array("levels", levels, 1000));
+    assert(sum_levels(stack) == 500);
+
+    int *points = in.add_array<int>("points", 4);
+    for (int i = 0; i < 4; ++i)
+        points[i] = i;
+    assert(in.get_array<int>("points")[3] == 3);
+
+    signal_parameters_t *p = signal_parameters_create();
+    double axis[3] = {1, 2, 3};
+    assert(signal_parameters_set_float_array(p, "levels", levels, 1000));
+    assert(signal_parameters_set_double_array(p, "axis", axis, 3));
+    assert(!signal_parameters_set_int_array(p, "axis", points, 4));
+    assert(signal_parameters_set_int_array(p, "empty", nullptr, 0));
+
+    size_t count = 0;
+    const double *a = signal_parameters_get_double_array(p, "axis", &count);
+    assert(a && count == 3 && a[2] == 3);
+    assert(reinterpret_cast<uintptr_t>(a) % SIGNAL_PARAMETERS_ARRAY_ALIGN ==
+           0);
+    assert(!signal_parameters_get_float_array(p, "axis", &count) && !count);
+    assert(signal_parameters_get_int_array(p, "empty", &count) && !count);
+    assert(signal_parameters_get_float_array(p, "levels", nullptr));
+    signal_parameters_free(p);
+    return 0;
+}
+
+int signal_static_test()
+{
+    cout << "---- Static Manager Test ----" << endl;
+    using namespace signal::literals;
+
+    static_assert(!signal::id_collision("input.key", "scene.changed"), "");
+    static_assert(signal::id_collision("input.key", "a", "input.key"), "");
+    static_assert("input.key"_sig == SIGNAL_ID("input.key"), "");
+
+    typedef signal::static_manager<"input.key"_sig, "scene.changed"_sig,
+                                   SIGNAL_ID("audio.level")>
+        static_signals;
+    static_assert(static_signals::index<"scene.changed"_sig>() == 1, "");
+
+    static_signals m;
+    int keys = 0, scenes = 0;
+    assert(m.add<"input.key"_sig>([&keys](const signal::parameters &p,
+                                          signal::parameters *) {
+        keys += p.get<int>("key");
+    }));
+    assert(m.add<"scene.changed"_sig>(
+        [&scenes](const signal::parameters &, signal::parameters *) {
+            ++scenes;
+        }));
+    assert(m.add<"scene.changed"_sig>(cpp_signal2));
+    assert(!m.add<"scene.changed"_sig>(cpp_signal2));
+
+    signal::parameters in;
+    assert(in.add<int>("key", 3));
+    m.send<"input.key"_sig>(in);
+    assert(m.send("input.key", in));
+    assert(m.send("scene.changed"_sig));
+    assert(!m.send("unknown"));
+    assert(keys == 6 && scenes == 1);
+    return 0;
+}
+
+int signal_lazy_test()
+{
+    cout << "---- Lazy Parameters Test ----" << endl;
+
+    signal::manager m;
+    assert(m.add("ignored"));
+    assert(!m.has_receivers("ignored") && !m.has_receivers("unknown"));
+    assert(m.add_filtered("filtered", "key", 1, cpp_signal2));
+    assert(m.has_receivers("filtered"));
+
+    int generated = 0;
+    auto make_name = [&generated]() {
+        ++generated;
+        return string("a rather long generated string value");
+    };
+
+    signal::parameters in;
+    assert(in.add_lazy<string>("name", make_name));
+    assert(!in.add_lazy<string>("name", make_name));
+    assert(in.add<int>("key", 2));
+    assert(m.send("ignored", in) && m.send("filtered", in));
+    assert(generated == 0);
+
+    string read;
+    assert(m.add("reader", [&read](const signal::parameters &p,
+                                   signal::parameters *) {
+        read = p.get<string>("name");
+    }));
+    assert(m.add("reader", [&read](const signal::parameters &p,
+                                   signal::parameters *) {
+        assert(p.get<string>("name") == read);
+    }));
+    assert(m.has_receivers("reader"));
+    assert(m.send("reader", in));
+    assert(generated == 1 && read == make_name());
+    generated = 0;
+
+    /* Copies keep the evaluated value, so they don't run the generator */
+    signal::parameters copy(in);
+    bool ok = false;
+    assert(copy.get<int>("name", &ok) == 0 && !ok);
+    assert(copy.get<string>("name") == read && generated == 0);
+
+    signal::parameters lazy_copy;
+    assert(lazy_copy.add_lazy<double>("pi", [] { return 3.14; }));
+    signal::parameters lazy_copy2(lazy_copy);
+    size_t size = 0;
+    assert(lazy_copy2.get_direct("pi", size) && size == sizeof(double));
+    assert(lazy_copy2.get<double>("pi") == 3.14);
+    return 0;
+}
+
+int signal_policy_test()
+{
+    cout << "---- Send Policy Test ----" << endl;
+
+    signal::manager m;
+    int nth = 0, interval = 0, limited = 0;
+    assert(m.add("nth", [&nth](const signal::parameters &,
+                               signal::parameters *) { ++nth; }));
+    assert(m.add("interval", [&interval](const signal::parameters &,
+                                         signal::parameters *) {
+        ++interval;
+    }));
+    assert(m.add("limited", [&limited](const signal::parameters &,
+                                       signal::parameters *) { ++limited; }));
+    assert(!m.set_policy("unknown", signal::send_policy::every(2)));
+    assert(m.set_policy("nth", signal::send_policy::every(3)));
+    assert(m.set_policy("interval", signal::send_policy::at_most_every(
+                                        std::chrono::hours(1))));
+    assert(m.set_policy("limited", signal::send_policy::limit(0.001, 5)));
+
+    for (int i = 0; i < 10; ++i) {
+        assert(m.send("nth"));
+        assert(m.send("interval"));
+        assert(m.send("limited"));
+    }
+    assert(nth == 4 && m.stats("nth").dropped == 6);
+    assert(interval == 1 && m.stats("interval").dropped == 9);
+    assert(limited == 5 && m.stats("limited").dropped == 5);
+
+    bool ok = true;
+    assert(m.stats("unknown", &ok).dropped == 0 && !ok);
+
+    /* Removing the policy lets every send through again */
+    assert(m.set_policy("nth", signal::send_policy()));
+    assert(m.send("nth") && m.send("nth") && nth == 6);
+    assert(m.stats("nth").dropped == 0);
+    return 0;
+}
+
+int signal_freeze_test()
+{
+    cout << "---- Freeze Test ----" << endl;
+
+    signal::manager m;
+    int count = 0;
+    auto recv = [&count](const signal::parameters &, signal::parameters *) {
+        ++count;
+    };
+    for (int i = 0; i < 1000; ++i)
+        assert(m.add("signal.with.a.long.name." + to_string(i), recv));
+    assert(m.set_policy("signal.with.a.long.name.7",
+                        signal::send_policy::every(2)));
+
+    size_t before = m.memory_usage();
+    m.freeze();
+    assert(m.frozen());
+    assert(m.memory_usage() < before);
+
+    for (int i = 0; i < 1000; ++i)
+        assert(m.send("signal.with.a.long.name." + to_string(i)));
+    assert(count == 1000);
+    assert(!m.send("signal.with.a.long.name.1000"));
+    assert(!m.send("") && !m.has_receivers("unknown"));
+    assert(m.send("signal.with.a.long.name.7") && count == 1000);
+    assert(m.stats("signal.with.a.long.name.7").dropped == 1);
+
+    /* Frozen lookups don't allocate */
+    const char *id = "signal.with.a.long.name.42";
+    expect_no_alloc { assert(m.send(id)); }
+
+    /* Existing signals take new receivers, new ids rebuild the table */
+    assert(m.add("signal.with.a.long.name.42", quiet_signal));
+    assert(m.add("late", recv) && m.frozen());
+    count = 0;
+    assert(m.send("late") && m.send(id) && count == 2);
+    assert(m.send("signal.with.a.long.name.999") && count == 3);
+
+    m.thaw();
+    assert(!m.frozen());
+    assert(m.send("late") && m.send(id) && count == 5);
+    return 0;
+}
+
+/* Sends a lazy value whose generator captures a local of this frame */
+static void send_lazy_scene(signal::manager &m, std::string_view id,
+                            int &runs)
+{
+    std::string name = "lazy scene name which doesn't fit inline";
+    signal::parameters p;
+    p.add_lazy<size_t>("length", [&name, &runs] {
+        ++runs;
+        return name.size();
+    });
+    m.send(id, p);
+}
+
+int signal_sticky_test()
+{
+    cout << "---- Sticky Signal Test ----" << endl;
+
+    signal::manager m;
+    int scene = -1, filtered = 0;
+    auto recv = [&scene](const signal::parameters &in, signal::parameters *) {
+        scene = in.get<int>("scene");
+    };
+    assert(m.add("scene.changed"));
+    assert(!m.set_sticky("unknown"));
+    assert(m.set_sticky("scene.changed"));
+
+    bool ok = true;
+    assert(m.last("scene.changed", &ok).get().empty() && !ok);
+
+    /* Nothing was sent yet, so the receiver isn't called */
+    assert(m.add("scene.changed", recv) && scene == -1);
+
+    signal::parameters p;
+    p.add<int>("scene", 3);
+    assert(m.send("scene.changed", p) && scene == 3);
+    p.reset();
+    p.add<int>("scene", 4);
+    assert(m.send("scene.changed", p) && scene == 4);
+
+    /* Late receivers get the last value right away */
+    int late = -1;
+    assert(m.add("scene.changed", [&late](const signal::parameters &in,
+                                          signal::parameters *) {
+        late = in.get<int>("scene");
+    }));
+    assert(late == 4);
+    assert(m.add_filtered("scene.changed", "scene", 4,
+                          [&filtered](const signal::parameters &,
+                                      signal::parameters *) { ++filtered; }));
+    assert(m.add_filtered("scene.changed", "scene", 5,
+                          [&filtered](const signal::parameters &,
+                                      signal::parameters *) { ++filtered; }));
+    assert(filtered == 1);
+
+    /* Snapshots are not changed by later sends */
+    auto snapshot = m.last("scene.changed", &ok);
+    assert(ok && snapshot->get<int>("scene") == 4);
+    p.reset();
+    p.add<int>("scene", 5);
+    assert(m.send("scene.changed", p) && scene == 5 && filtered == 2);
+    assert(snapshot->get<int>("scene") == 4);
+    assert(m.last("scene.changed")->get<int>("scene") == 5);
+
+    /* Lazy values are stored evaluated, the sender's frame is gone when
+     * the late receiver reads them */
+    assert(m.add("scene.lazy") && m.set_sticky("scene.lazy"));
+    int runs = 0;
+    send_lazy_scene(m, "scene.lazy", runs);
+    assert(runs == 1);
+    size_t length = 0;
+    assert(m.add("scene.lazy", [&length](const signal::parameters &in,
+                                         signal::parameters *) {
+        length = in.get<size_t>("length");
+    }));
+    assert(length == 40 && runs == 1);
+
+    /* Without evaluating, only lazy values which a receiver read are kept */
+    assert(m.set_sticky("scene.lazy", true, false));
+    send_lazy_scene(m, "scene.lazy", runs);
+    assert(runs == 2);
+    assert(m.last("scene.lazy").get().get<size_t>("length") == 40);
+    assert(m.add("scene.unread"));
+    assert(m.set_sticky("scene.unread", true, false));
+    send_lazy_scene(m, "scene.unread", runs);
+    assert(runs == 2 && m.last("scene.unread", &ok).get().empty() && ok);
+
+    /* Non sticky signals don't keep anything */
+    assert(m.set_sticky("scene.changed", false));
+    assert(m.last("scene.changed", &ok).get().empty() && !ok);
+    return 0;
+}
+
+int signal_timer_test()
+{
+    cout << "---- Timer Test ----" << endl;
+
+    typedef signal::timer_wheel::clock clock;
+    using std::chrono::milliseconds;
+    using std::chrono::seconds;
+
+    /* Every manager has its own wheel, the tests below move the wheels
+     * ahead of the real time so each one uses a new manager */
+    signal::manager m, periodic, late_m, threaded_m;
+    int once = 0, every = 0, late = 0;
+    auto count = [](int &n) {
+        return [&n](const signal::parameters &, signal::parameters *) {
+            ++n;
+        };
+    };
+    assert(m.add("once", [&once](const signal::parameters &in,
+                                 signal::parameters *) {
+        once += in.get<int>("value");
+    }));
+    assert(!m.send_after("unknown", milliseconds(1)).valid());
+
+    auto start = clock::now();
+    signal::parameters p;
+    p.add<int>("value", 3);
+    auto t = m.send_after("once", milliseconds(10), std::move(p));
+    assert(t.valid());
+    assert(m.advance_timers(start) == 0 && once == 0);
+    assert(m.advance_timers(start + milliseconds(50)) == 1 && once == 3);
+    assert(!m.cancel(t));
+
+    /* Periodic sends keep running until they are cancelled */
+    assert(periodic.add("every", count(every)));
+    start = clock::now();
+    auto e = periodic.send_every("every", milliseconds(5));
+    for (int i = 1; i <= 20; ++i)
+        periodic.advance_timers(start + milliseconds(5 * i));
+    assert(every >= 19 && every <= 20);
+    assert(periodic.cancel(e) && !periodic.cancel(e));
+    periodic.advance_timers(start + seconds(1));
+    assert(every >= 19 && every <= 20);
+
+    /* Timers on the upper levels are moved down until they expire, even
+     * if time jumps ahead */
+    assert(late_m.add("late", count(late)));
+    start = clock::now();
+    late_m.send_after("late", seconds(70));
+    late_m.send_after("late", std::chrono::hours(24 * 60));
+    late_m.advance_timers(start + seconds(69));
+    assert(late == 0);
+    late_m.advance_timers(start + seconds(71));
+    assert(late == 1);
+
+    /* Lots of timers stay cheap */
+    size_t before = m.memory_usage();
+    std::vector<signal::timer_handle> handles;
+    for (int i = 0; i < 100000; ++i)
+        handles.push_back(m.send_after("once", milliseconds(i * 37)));
+    assert(m.memory_usage() - before < 8 * 1024 * 1024);
+    for (auto h : handles)
+        assert(m.cancel(h));
+    m.advance_timers(clock::now() + std::chrono::hours(2));
+    assert(once == 3);
+
+    /* The timer thread sends on its own */
+    std::atomic<int> threaded{0};
+    assert(threaded_m.add("threaded", [&threaded](const signal::parameters &,
+                                                  signal::parameters *) {
+        ++threaded;
+    }));
+    threaded_m.start_timers();
+    threaded_m.send_after("threaded", milliseconds(1));
+    for (int i = 0; i < 1000 && !threaded; ++i)
+        std::this_thread::sleep_for(milliseconds(1));
+    threaded_m.stop_timers();
+    assert(threaded == 1);
+
+    /* Assigning a manager stops its timer thread before the signals are
+     * replaced */
+    threaded_m.start_timers();
+    threaded_m.send_every("threaded", milliseconds(1));
+    for (int i = 0; i < 1000 && threaded < 3; ++i)
+        std::this_thread::sleep_for(milliseconds(1));
+    threaded_m = signal::manager();
+    assert(threaded >= 3 && !threaded_m.has_receivers("threaded"));
+    return 0;
+}
+
+int signal_connect_test()
+{
+    cout << "---- Connect Test ----" << endl;
+
+    signal::manager m;
+    int raw = 0, key = 0, pressed = 0, logged = 0;
+    assert(m.add("raw.input", [&raw](const signal::parameters &in,
+                                     signal::parameters *) {
+        raw = in.get<int>("code");
+    }));
+    assert(m.add("input.key", [&key](const signal::parameters &in,
+                                     signal::parameters *) {
+        key = in.get<int>("key");
+    }));
+    assert(m.add("input.log", [&logged](const signal::parameters &,
+                                        signal::parameters *) { ++logged; }));
+
+    auto decode = [](const signal::parameters &in, signal::parameters *out) {
+        out->add<int>("key", in.get<int>("code") * 2);
+    };
+    assert(m.connect("raw.input", "input.key", decode));
+    assert(m.connect("raw.input", "input.log"));
+    assert(m.connect("input.key", "key.pressed"));
+    assert(m.add("key.pressed", [&pressed](const signal::parameters &in,
+                                           signal::parameters *) {
+        pressed = in.get<int>("key");
+    }));
+
+    /* Duplicates and cycles are rejected */
+    assert(!m.connect("raw.input", "input.log"));
+    assert(!m.connect("key.pressed", "raw.input"));
+    assert(!m.connect("input.key", "input.key"));
+
+    signal::parameters p;
+    p.add<int>("code", 21);
+    assert(m.send("raw.input", p));
+    assert(raw == 21 && key == 42 && pressed == 42 && logged == 1);
+
+    /* The transformed parameters are reused by later sends */
+    p.reset();
+    p.add<int>("code", 5);
+    expect_no_alloc { assert(m.send("raw.input", p)); }
+    assert(key == 10 && pressed == 10 && logged == 2);
+
+    /* Dropping a send skips the signals connected to it */
+    assert(m.set_policy("input.key", signal::send_policy::every(2)));
+    p.reset();
+    p.add<int>("code", 1);
+    assert(m.send("raw.input", p) && key == 2 && pressed == 2);
+    assert(m.send("raw.input", p) && logged == 4);
+    assert(key == 2 && pressed == 2);
+    assert(m.set_policy("input.key", signal::send_policy()));
+
+    /* Connections survive freezing and copying */
+    m.freeze();
+    auto copy = m;
+    p.reset();
+    p.add<int>("code", 7);
+    assert(m.send("raw.input", p) && pressed == 14 && logged == 5);
+    m = signal::manager();
+    p.reset();
+    p.add<int>("code", 8);
+    assert(copy.send("raw.input", p) && pressed == 16 && logged == 6);
+    return 0;
+}
+
+int signal_post_test()
+{
+    cout << "---- Post Test ----" << endl;
+
+    signal::manager m;
+    int sum = 0;
+    assert(m.add("posted", [&sum](const signal::parameters &in,
+                                  signal::parameters *) {
+        sum += in.get<int>("value");
+    }));
+    assert(!m.post("unknown"));
+    assert(m.process_ready() == 0);
+
+    /* A burst of posts from another thread */
+    std::thread sender([&m] {
+        for (int i = 0; i < 10000; ++i) {
+            signal::parameters p;
+            p.add<int>("value", 1);
+            m.post("posted", std::move(p));
+        }
+    });
+    sender.join();
+    assert(sum == 0);
+
+#ifdef LINUX
+    /* The burst woke up the event loop only once */
+    pollfd pfd = {m.fd(), POLLIN, 0};
+    assert(pfd.fd >= 0 && poll(&pfd, 1, 0) == 1);
+
+    /* The fd stays readable until the queue is empty */
+    assert(m.process_ready(100) == 100 && sum == 100);
+    assert(poll(&pfd, 1, 0) == 1);
+    assert(m.process_ready() == 9900 && sum == 10000);
+    assert(poll(&pfd, 1, 0) == 0);
+
+    assert(m.post("posted") && m.post("posted"));
+    uint64_t wakeups = 0;
+    assert(read(m.fd(), &wakeups, sizeof(wakeups)) == sizeof(wakeups));
+    assert(wakeups == 1);
+    assert(m.process_ready() == 2);
+#else
+    assert(m.process_ready() == 10000 && sum == 10000);
+#endif
+
+    /* C API */
+    signal_manager_t *cm = signal_manager_create();
+    signal_parameters_t *in = signal_parameters_create();
+    assert(signal_add(cm, "signal2", c_signal2));
+    assert(signal_parameters_set_int(in, "int", 1));
+    assert(signal_post(cm, "signal2", in));
+    assert(signal_post(cm, "signal2", NULL));
+    assert(!signal_post(cm, "unknown", NULL) && !signal_post(NULL, "a", in));
+    assert(signal_manager_get_fd(NULL) == -1);
+#ifdef LINUX
+    assert(signal_manager_get_fd(cm) >= 0);
+#endif
+    assert(signal_process_ready(cm, 1) == 1);
+    assert(signal_process_ready(cm, 10) == 1);
+    assert(signal_process_ready(NULL, 10) == 0);
+    signal_parameters_free(in);
+    signal_manager_free(cm);
+    return 0;
+}
+
+int signal_realtime_test()
+{
+    cout << "---- Real-time Test ----" << endl;
+
+    /* Fixed parameters fail instead of allocating once they are full */
+    signal::fixed_parameters<256> fixed;
+    expect_no_alloc
+    {
+        int i = 0;
+        while (fixed.add<double>("value" + std::to_string(i), i))
+            ++i;
+        assert(i > 0 && fixed.size() == size_t(i));
+    }
+    signal::parameters big;
+    for (int i = 0; i < 64; ++i)
+        big.add<double>("value" + to_string(i), i);
+    assert(!fixed.assign(big) && fixed.empty());
+
+    auto *m = new signal::rt_manager<8, 16, 4>();
+    float level = 0;
+    std::atomic<int> deferred{0};
+    float deferred_level = 0;
+    assert(m->add("audio.level", [&level](const signal::parameters &in,
+                                          signal::parameters *) {
+        level = in.get<float>("level");
+    }));
+    assert(m->add_deferred("audio.level",
+                           [&](const signal::parameters &in,
+                               signal::parameters *) {
+                               deferred_level = in.get<float>("level");
+                               ++deferred;
+                           }));
+    assert(m->add("audio.clip", quiet_signal));
+    assert(!m->add("audio.clip", quiet_signal));
+
+    /* The real-time path doesn't allocate, sends which don't fit into the
+     * queue are dropped */
+    char buf[signal::parameters::storage_size(1, 16)];
+    signal::parameters p(buf, sizeof(buf), true);
+    expect_no_alloc
+    {
+        for (int i = 1; i <= 6; ++i) {
+            p.reset();
+            p.add<float>("level", 0.1f * i);
+            assert(m->send("audio.level", p));
+        }
+        assert(m->send("audio.clip"));
+        assert(!m->send("unknown"));
+    }
+    assert(std::fabs(level - 0.6f) < FLOAT_LENIENCY);
+    assert(deferred == 0 && m->dropped() == 2);
+
+    /* Deferred receivers run on another thread */
+    std::thread worker([m] { assert(m->process_deferred() == 4); });
+    worker.join();
+    assert(deferred == 4 && std::fabs(deferred_level - 0.4f) < 0.0001f);
+
+    /* The manager is full */
+    for (int i = 0; i < 6; ++i)
+        assert(m->add("signal." + to_string(i), quiet_signal));
+    assert(!m->add("signal.6", quiet_signal));
+    delete m;
+    return 0;
+}
+
+int signal_ring_test()
+{
+    cout << "---- Ring Buffer Test ----" << endl;
+
+    const int64_t events = 20000;
+    for (auto strategy : {signal::wait_strategy::busy_spin,
+                          signal::wait_strategy::yield,
+                          signal::wait_strategy::block}) {
+        signal::ring_buffer ring(1000, 64, strategy);
+        assert(ring.size() == 1024);
+
+        /* Two independent consumers and a stage after the first one, all of
+         * them have to see every event in order */
+        int64_t seen[3] = {0, 0, 0};
+        bool ordered[3] = {true, true, true};
+        for (int i = 0; i < 3; ++i) {
+            auto check = [&seen, &ordered, i](const signal::parameters &in,
+                                              signal::parameters *) {
+                if (in.get<int64_t>("seq") != seen[i]) ordered[i] = false;
+                ++seen[i];
+            };
+            assert(ring.add_consumer(check, i == 2 ? 0 : -1) == size_t(i));
+        }
+        ring.start();
+
+        /* Publishing reuses the slots, so it doesn't allocate once the
+         * ring went around once */
+        for (int64_t i = 0; i < 1024; ++i)
+            ring.publish_with(
+                [i](signal::parameters &p) { p.add<int64_t>("seq", i); });
+        expect_no_alloc
+        {
+            char buf[signal::parameters::storage_size(1, 16)];
+            signal::parameters event(buf, sizeof(buf));
+            for (int64_t i = 1024; i < events; ++i) {
+                event.reset();
+                event.add<int64_t>("seq", i);
+                ring.publish(event);
+            }
+        }
+        ring.stop();
+
+        assert(ring.published() == uint64_t(events));
+        for (int i = 0; i < 3; ++i)
+            assert(seen[i] == events && ordered[i]);
+    }
+
+    /* Registered like any other receiver and polled manually */
+    signal::manager m;
+    signal::ring_buffer ring(4);
+    int64_t sum = 0;
+    ring.add_consumer([&sum](const signal::parameters &in,
+                             signal::parameters *) {
+        sum += in.get<int>("value");
+    });
+    assert(m.add("telemetry", ring.publisher()));
+    assert(!m.add("telemetry", ring.publisher()));
+    for (int i = 1; i <= 4; ++i) {
+        signal::parameters p;
+        p.add<int>("value", i);
+        assert(m.send("telemetry", p));
+    }
+    assert(ring.poll(0) == 4 && sum == 10);
+    assert(ring.poll(0) == 0);
+    return 0;
+}
+
+struct counting_receiver {
+    std::atomic<int> *count;
+    int id;
+
+    void operator()(const signal::parameters &, signal::parameters *) const
+    {
+        ++*count;
+    }
+
+    bool operator==(const counting_receiver &o) const
+    {
+        return count == o.count && id == o.id;
+    }
+};
+
+int signal_sharded_test()
+{
+    cout << "---- Sharded Manager Test ----" << endl;
+
+    /* Removing receivers from the regular manager */
+    signal::manager plain;
+    int filtered = 0;
+    auto on_key = [&filtered](const signal::parameters &,
+                              signal::parameters *) { ++filtered; };
+    assert(plain.add("signal2", cpp_signal2));
+    assert(plain.add_filtered("key", "code", 1, cpp_signal2));
+    assert(plain.add_filtered("key", "code", 2, on_key));
+    assert(plain.remove("signal2", cpp_signal2));
+    assert(!plain.remove("signal2", cpp_signal2));
+    assert(!plain.remove("unknown", cpp_signal2));
+    assert(!plain.has_receivers("signal2"));
+    assert(plain.remove("key", cpp_signal2) && plain.has_receivers("key"));
+
+    signal::sharded_manager m(8);
+    assert(m.shard_count() == 8);
+    std::atomic<int> count{0};
+    assert(m.add("static", counting_receiver{&count, -1}));
+    assert(!m.add("static", counting_receiver{&count, -1}));
+    assert(m.send("static") && count == 1);
+    assert(!m.send("unknown"));
+
+    /* Threads add and remove receivers of their own signals while another
+     * thread keeps sending */
+    std::atomic<bool> done{false};
+    std::thread sender([&] {
+        while (!done)
+            m.send("static");
+    });
+
+    std::vector<std::thread> workers;
+    std::atomic<int> churn{0};
+    for (int t = 0; t < 4; ++t) {
+        workers.emplace_back([&m, &churn, t] {
+            std::string id = "overlay." + to_string(t);
+            for (int i = 0; i < 2000; ++i) {
+                counting_receiver r{&churn, i};
+                assert(m.add(id, r));
+                assert(m.send(id));
+                assert(m.remove(id, r));
+            }
+            assert(!m.has_receivers(id));
+        });
+    }
+    for (auto &w : workers)
+        w.join();
+    done = true;
+    sender.join();
+
+    /* Every receiver was called by the send right after its add */
+    assert(churn == 4 * 2000);
+
+    /* Receivers spanning several chunks keep their order when some are
+     * removed, an emptied chunk is dropped */
+    const int chunk = int(signal::sharded_manager::chunk_size);
+    const int many = 3 * chunk;
+    std::vector<int> order;
+    auto ordered = [&order](int n) {
+        return [&order, n](const signal::parameters &,
+                           signal::parameters *) { order.push_back(n); };
+    };
+    std::vector<counting_receiver> listed;
+    std::atomic<int> listed_calls{0};
+    for (int i = 0; i < many; ++i) {
+        listed.push_back({&listed_calls, i});
+        assert(m.add("many", listed.back()));
+    }
+    assert(!m.add("many", listed[many / 2]));
+    assert(m.add("many", ordered(1)));
+    for (int i = 0; i < many; i += 2)
+        assert(m.remove("many", listed[i]));
+    for (int i = 1; i < chunk; i += 2)
+        assert(m.remove("many", listed[i]));
+    assert(!m.remove("many", listed[0]));
+    assert(m.add("many", ordered(2)));
+    assert(m.send("many") && listed_calls == many / 2 - chunk / 2);
+    assert((order == std::vector<int>{1, 2}));
+    assert(m.add("empty") && m.send("empty") && !m.has_receivers("empty"));
+    assert(m.remove("static") && !m.remove("static"));
+    assert(!m.has_receivers("static"));
+    return 0;
+}
+
+int signal_distinct_test()
+{
+    cout << "---- Distinct Test ----" << endl;
+
+    /* Equality and fingerprints don't depend on the order of the values */
+    signal::parameters a, b;
+    a.add<int>("x", 1);
+    a.add<std::string>("name", "mouse");
+    a.add<double>("scale", 0.0);
+    b.add<double>("scale", -0.0);
+    b.add<std::string>("name", "mouse");
+    b.add<int>("x", 1);
+    assert(a == b && a.fingerprint() == b.fingerprint());
+    assert(std::hash<signal::parameters>()(a) == a.fingerprint());
+
+    signal::parameters nan1, nan2;
+    nan1.add<float>("v", std::numeric_limits<float>::quiet_NaN());
+    nan2.add<float>("v", -std::numeric_limits<float>::quiet_NaN());
+    assert(nan1 == nan2 && nan1.fingerprint() == nan2.fingerprint());
+
+    b.add<int>("y", 2);
+    assert(a != b);
+    signal::parameters c;
+    c.add<int>("x", 2);
+    c.add<std::string>("name", "mouse");
+    c.add<double>("scale", 0.0);
+    assert(a != c && a.fingerprint() != c.fingerprint());
+
+    signal::parameters lazy;
+    lazy.add_lazy<int>("x", [] { return 1; });
+    lazy.add<std::string>("name", "mouse");
+    lazy.add<double>("scale", 0.0);
+    assert(lazy == a && lazy.fingerprint() == a.fingerprint());
+
+    signal::manager m;
+    int calls = 0;
+    assert(m.add("cursor", [&calls](const signal::parameters &,
+                                    signal::parameters *) { ++calls; }));
+    assert(!m.set_distinct("unknown"));
+    assert(m.set_distinct("cursor"));
+
+    signal::parameters p;
+    p.add<int>("x", 5);
+    assert(m.send("cursor", p) && calls == 1);
+    assert(m.send("cursor", p) && calls == 1);
+    signal::parameters q;
+    q.add<int>("x", 6);
+    assert(m.send("cursor", q) && calls == 2);
+    assert(m.send("cursor", p) && calls == 3);
+    assert(m.stats("cursor").suppressed == 1);
+
+    /* Checking an unchanged send doesn't allocate */
+    expect_no_alloc
+    {
+        m.send("cursor", p);
+    }
+    assert(calls == 3 && m.stats("cursor").suppressed == 2);
+
+    m.set_distinct("cursor", false);
+    assert(m.send("cursor", p) && calls == 4);
+    assert(m.stats("cursor").suppressed == 0);
+    return 0;
+}
+
+int signal_counters_test()
+{
+    cout << "---- Counters Test ----" << endl;
+
+    signal::manager m;
+    int calls = 0;
+    auto recv = [&calls](const signal::parameters &, signal::parameters *) {
+        ++calls;
+    };
+    assert(m.add("frame", recv));
+    assert(m.add_filtered("key", "code", 1, recv));
+    m.set_counters();
+    std::atomic<int> late{0};
+    assert(m.add("late", counting_receiver{&late, 0}));
+    assert(m.remove("late", counting_receiver{&late, 0}));
+
+    for (int i = 0; i < 40; i++)
+        assert(m.send("frame"));
+    assert(m.send("late"));
+    assert(calls == 40);
+
+    auto s = m.stats("frame");
+    assert(s.sends == 40 && s.misses == 0 && s.receivers == 1);
+    uint64_t timed = 0;
+    for (auto n : s.latency)
+        timed += n;
+    assert(timed == 3);
+    s = m.stats("late");
+    assert(s.sends == 1 && s.misses == 1 && s.receivers == 0);
+    assert(m.stats("key").receivers == 1);
+
+    /* Sends forwarded by connect() count for the target */
+    signal::manager routed;
+    routed.set_counters();
+    assert(routed.add("frame", recv));
+    assert(routed.connect("frame", "frame.log"));
+    assert(routed.connect("frame.log", "frame.draw"));
+    assert(routed.add("frame.draw", recv));
+    for (int i = 0; i < 17; i++)
+        assert(routed.send("frame"));
+    s = routed.stats("frame.log");
+    assert(s.sends == 17 && s.misses == 17);
+    timed = 0;
+    for (auto n : s.latency)
+        timed += n;
+    assert(timed == 2);
+    assert(routed.stats("frame.draw").sends == 17 && calls == 74);
+
+    /* Counting a send doesn't allocate */
+    expect_no_alloc
+    {
+        m.send("frame");
+    }
+
+    size_t published = 0;
+    m.for_each_stats([&](std::string_view, const signal::signal_stats &) {
+        ++published;
+    });
+    assert(published == 3);
+
+    m.set_counters(false);
+    m.send("frame");
+    assert(m.stats("frame").sends == 0);
+
+#ifdef LINUX
+    m.set_counters();
+    m.send("frame");
+    const std::string name = "/libsignal_test." + std::to_string(getpid());
+    {
+        signal::stats_publisher publisher(name, 2);
+        assert(publisher.ok());
+        assert(publisher.publish(m) == 2);
+
+        signal::stats_reader reader(name);
+        assert(reader.ok() && reader.pid() == uint64_t(getpid()));
+        assert(reader.size() == 2 && reader.published() == 1);
+
+        signal::stats_record r;
+        bool found = false;
+        for (size_t i = 0; i < reader.size(); i++) {
+            assert(reader.read(i, r));
+            if (std::string(r.id) != "frame") continue;
+            found = true;
+            assert(r.stats.sends == 1 && r.stats.receivers == 1);
+            assert(r.stats.latency[0] + r.stats.latency[15] <= 1);
+        }
+        assert(found && !reader.read(2, r));
+
+        /* Every counter survives the shared memory layout */
+        signal::signal_stats all;
+        all.muted = 3;
+        all.cache_hits = 4;
+        all.cache_misses = 5;
+        uint64_t words[signal::shm::record_words];
+        signal::shm::pack("all", all, words);
+        signal::shm::unpack(words, r);
+        assert(std::string(r.id) == "all" && r.stats.muted == 3);
+        assert(r.stats.cache_hits == 4 && r.stats.cache_misses == 5);
+
+        /* Sends don't change the segment until the next publish */
+        m.send("frame");
+        assert(reader.published() == 1);
+        publisher.publish(m);
+        assert(reader.published() == 2);
+    }
+    assert(!signal::stats_reader(name).ok());
+#endif
+    return 0;
+}
+
+int signal_memoize_test()
+{
+    cout << "---- Memoize Test ----" << endl;
+
+    signal::manager m;
+    int calls = 0;
+    assert(m.add("square", [&calls](const signal::parameters &in,
+                                    signal::parameters *out) {
+        ++calls;
+        int x = in.get<int>("x");
+        if (out) out->add<int>("result", x * x);
+    }));
+    assert(!m.set_memoize("unknown"));
+    assert(m.set_memoize("square", 2));
+
+    signal::parameters in, out;
+    in.add<int>("x", 3);
+    assert(m.send("square", in, &out) && calls == 1);
+    assert(out.get<int>("result") == 9);
+    out.reset();
+    assert(m.send("square", in, &out) && calls == 1);
+    assert(out.get<int>("result") == 9);
+
+    /* Sends without a response always run the receivers */
+    assert(m.send("square", in) && calls == 2);
+
+    /* A hit doesn't allocate once the response has room */
+    expect_no_alloc
+    {
+        m.send("square", in, &out);
+    }
+    auto s = m.stats("square");
+    assert(s.cache_hits == 2 && s.cache_misses == 1 && calls == 2);
+
+    /* The least recently used response is replaced */
+    signal::parameters four, five;
+    four.add<int>("x", 4);
+    five.add<int>("x", 5);
+    auto query = [&m, &out](const signal::parameters &p) {
+        out.reset();
+        assert(m.send("square", p, &out));
+        return out.get<int>("result");
+    };
+    query(four);
+    query(in);
+    assert(query(five) == 25 && calls == 4);
+    assert(query(in) == 9 && calls == 4);
+    assert(query(four) == 16 && calls == 5);
+
+    assert(m.invalidate("square") && !m.invalidate("unknown"));
+    assert(query(four) == 16 && calls == 6);
+
+    m.set_memoize("square", 0);
+    query(four);
+    query(four);
+    assert(calls == 8 && m.stats("square").cache_hits == 0);
+
+    /* A distinct signal still answers a repeated query from the cache */
+    assert(m.set_memoize("square", 2) && m.set_distinct("square"));
+    assert(query(four) == 16 && calls == 9);
+    assert(query(four) == 16 && calls == 9);
+    assert(m.stats("square").suppressed == 0);
+
+    /* Adding a receiver drops the cached responses */
+    int offset = 0;
+    auto add_offset = [&offset](const signal::parameters &,
+                                signal::parameters *out) {
+        if (out) out->add<int>("offset", ++offset);
+    };
+    assert(m.add("square", add_offset));
+    query(four);
+    assert(calls == 10 && offset == 1);
+    query(four);
+    assert(calls == 10 && offset == 1);
+
+    /* A hit would skip routes and sticky values, so they are rejected */
+    assert(!m.connect("square", "square.log") && m.connect("log", "square"));
+    assert(!m.set_sticky("square"));
+    assert(m.set_sticky("log") && !m.set_memoize("log"));
+
+    /* Only the values the receivers added are cached, a hit adds them to
+     * the response and counts as a send */
+    m.set_counters();
+    const uint64_t hits = m.stats("square").cache_hits;
+    signal::parameters six;
+    six.add<int>("x", 6);
+    out.reset();
+    out.add<int>("caller", 1);
+    assert(m.send("square", six, &out) && calls == 11);
+    signal::parameters fresh;
+    fresh.add<int>("offset", -1);
+    assert(m.send("square", six, &fresh) && calls == 11);
+    assert(fresh.get<int>("result") == 36 && fresh.get<int>("offset") == -1);
+    assert(!fresh.get_direct("caller") && fresh.size() == 2);
+    s = m.stats("square");
+    assert(s.sends == 2 && s.cache_hits == hits + 1);
+    return 0;
+}
+
+int signal_aggregate_test()
+{
+    cout << "---- Aggregate Test ----" << endl;
+
+    signal::manager m;
+    signal::window_sum<int> sum("value", 4);
+    signal::window_mean<float> mean("axis", 3);
+    signal::window_minmax<int> minmax("value", 3);
+    signal::ewma<int> average("value", 0.5);
+    assert(m.add("input", sum.receiver()));
+    assert(!m.add("input", sum.receiver()));
+    assert(m.add("input", minmax.receiver()));
+    assert(m.add("joystick", mean.receiver()));
+    assert(m.connect("input", "input.ewma", average.transform()));
+
+    double forwarded = 0;
+    assert(m.add("input.ewma", [&forwarded](const signal::parameters &in,
+                                            signal::parameters *) {
+        forwarded = in.get<double>("ewma");
+    }));
+
+    bool ok = true;
+    minmax.min(&ok);
+    assert(!ok && mean.mean() == 0);
+
+    const int values[] = {5, 1, 4, 2, 3};
+    for (int v : values) {
+        signal::parameters p;
+        p.add<int>("value", v);
+        assert(m.send("input", p));
+    }
+    assert(sum.sum() == 10 && sum.count() == 4);
+    assert(minmax.min() == 2 && minmax.max() == 4);
+    assert(std::fabs(average.value() - 2.875) < 1e-9);
+    assert(forwarded == average.value());
+
+    /* Arrays are added as a batch, only the last values stay in the
+     * window */
+    signal::parameters batch;
+    int *data = batch.add_array<int>("value", 6);
+    for (int i = 0; i < 6; i++)
+        data[i] = 10 + i;
+    assert(m.send("input", batch));
+    assert(sum.sum() == 12 + 13 + 14 + 15);
+    assert(minmax.min() == 13 && minmax.max() == 15);
+
+    signal::parameters axis;
+    axis.add<float>("axis", 0.5f);
+    m.send("joystick", axis);
+    axis.reset();
+    float *samples = axis.add_array<float>("axis", 2);
+    samples[0] = 1.0f;
+    samples[1] = 1.5f;
+    m.send("joystick", axis);
+    assert(std::fabs(mean.mean() - 1.0) < 1e-6);
+
+    /* Sends without the key don't change the window */
+    m.send("joystick");
+    assert(std::fabs(mean.mean() - 1.0) < 1e-6);
+
+    /* Rates over one second in 10 buckets */
+    signal::rate<> clicks;
+    auto t0 = signal::rate<>::clock::now();
+    clicks.add(5, t0);
+    clicks.add(5, t0 + std::chrono::milliseconds(500));
+    assert(clicks.per_second(t0 + std::chrono::milliseconds(900)) == 10);
+    assert(clicks.per_second(t0 + std::chrono::milliseconds(1250)) == 5);
+    assert(clicks.per_second(t0 + std::chrono::seconds(5)) == 0);
+
+    assert(m.add("click", clicks.receiver()));
+    m.send("click");
+    m.send("click");
+    assert(clicks.per_second() == 2);
+    return 0;
+}
+
+int signal_groups_test()
+{
+    cout << "---- Groups Test ----" << endl;
+
+    enum : uint64_t { overlay = 1 << 0, audio = 1 << 1 };
+    signal::manager m;
+    int calls = 0;
+    auto recv = [&calls](const signal::parameters &, signal::parameters *) {
+        ++calls;
+    };
+    assert(m.add("overlay.fps", recv));
+    assert(m.add("overlay.volume", recv));
+    assert(m.add("scene", recv));
+    assert(m.set_groups("overlay.fps", overlay));
+    assert(m.set_groups("overlay.volume", overlay | audio));
+    assert(!m.set_groups("unknown", overlay));
+
+    m.mute(overlay);
+    assert(m.muted() == overlay);
+    assert(m.send("overlay.fps") && m.send("overlay.volume"));
+    assert(m.send("scene") && calls == 1);
+    assert(!m.send("unknown"));
+
+    /* A muted send doesn't allocate */
+    expect_no_alloc
+    {
+        m.send("overlay.fps");
+    }
+    assert(m.stats("overlay.fps").muted == 2);
+    assert(m.stats("overlay.volume").muted == 1);
+
+    m.mute(audio);
+    m.unmute(overlay);
+    assert(m.send("overlay.fps") && calls == 2);
+    assert(m.send("overlay.volume") && calls == 2);
+    m.unmute(audio);
+    assert(m.send("overlay.volume") && calls == 3 && m.muted() == 0);
+
+    /* Muted targets of a route are skipped as well */
+    assert(m.connect("scene", "overlay.fps"));
+    m.mute(overlay);
+    assert(m.send("scene") && calls == 4);
+    assert(m.stats("overlay.fps").muted == 3);
+    m.unmute(overlay);
+    assert(m.send("scene") && calls == 6);
+
+    /* C API */
+    signal_manager_t *cm = signal_manager_create();
+    assert(signal_add(cm, "signal2", c_signal2));
+    assert(signal_set_groups(cm, "signal2", audio));
+    assert(!signal_set_groups(cm, "unknown", audio));
+    assert(!signal_set_groups(NULL, "signal2", audio));
+    signal_mute(cm, audio);
+    assert(signal_send(cm, "signal2", NULL, NULL));
+    assert(signal_get_muted_count(cm, "signal2") == 1);
+    signal_unmute(cm, audio);
+    assert(signal_send(cm, "signal2", NULL, NULL));
+    assert(signal_get_muted_count(cm, "signal2") == 1);
+    assert(signal_get_muted_count(NULL, "signal2") == 0);
+    signal_manager_free(cm);
+    return 0;
+}
+
+int signal_schedule_test()
+{
+    cout << "---- Schedule Test ----" << endl;
+    typedef std::chrono::milliseconds ms;
+    using signal::post_class;
+    using signal::post_options;
+
+    signal::manager m;
+    std::vector<int> order;
+    assert(m.add("event", [&order](const signal::parameters &in,
+                                   signal::parameters *) {
+        order.push_back(in.get<int>("n"));
+    }));
+    auto post = [&m](int n, const post_options &options) {
+        signal::shared_parameters p;
+        p.mutate().add<int>("n", n);
+        return m.post("event", p, options);
+    };
+
+    /* Classes are drained in order, each one by the earliest deadline */
+    assert(post(1, post_options::of(post_class::bulk)));
+    assert(post(2, post_options::of(post_class::normal)));
+    assert(post(3, post_options::within(post_class::high, ms(900))));
+    assert(post(4, post_options::of(post_class::high)));
+    assert(post(5, post_options::within(post_class::high, ms(500))));
+    assert(post(6, post_options::of(post_class::critical)));
+    assert(post(7, post_options::of(post_class::bulk)));
+    assert(!m.post("unknown", {}, post_options()));
+    assert(m.process_ready(3) == 3);
+    assert(m.process_ready() == 4);
+    assert((order == std::vector<int>{6, 5, 3, 4, 2, 1, 7}));
+
+    /* Sends past their deadline are dropped */
+    order.clear();
+    assert(post(8, post_options::within(post_class::critical, ms(-1))));
+    assert(post(9, post_options::of(post_class::critical)));
+    assert(m.process_ready() == 1 && order == std::vector<int>{9});
+    assert(m.post_stats(post_class::critical).expired == 1);
+
+    /* A full queue rejects posts or makes them wait */
+    m.set_post_limit(post_class::bulk, 2);
+    assert(post(10, post_options::of(post_class::bulk)));
+    assert(post(11, post_options::of(post_class::bulk)));
+    assert(!post(12, post_options::of(post_class::bulk)));
+    assert(post(13, post_options::of(post_class::normal)));
+    auto s = m.post_stats(post_class::bulk);
+    assert(s.queued == 2 && s.limit == 2 && s.rejected == 1);
+
+    std::atomic<bool> posted{false};
+    std::thread producer([&] {
+        auto options = post_options::of(post_class::bulk);
+        options.wait = std::chrono::seconds(10);
+        posted = post(14, options);
+    });
+    std::this_thread::sleep_for(ms(20));
+    assert(!posted);
+    assert(m.process_ready(2) == 2);
+    producer.join();
+    assert(posted);
+    m.process_ready();
+    assert((order == std::vector<int>{9, 13, 10, 11, 14}));
+
+    /* A send which expires behind a slow one of the batch isn't counted */
+    auto slow = [](const signal::parameters &, signal::parameters *) {
+        std::this_thread::sleep_for(ms(100));
+    };
+    assert(m.add("slow", slow));
+    assert(m.post("slow", {}, post_options::of(post_class::critical)));
+    assert(post(15, post_options::within(post_class::high, ms(50))));
+    assert(m.process_ready() == 1 && order.size() == 5);
+    assert(m.post_stats(post_class::high).expired == 1);
+    return 0;
+}
+
 int signal_cpp_test()
 {
     cout << "---- C++ Test ----" << endl;
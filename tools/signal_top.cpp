@@ -0,0 +1,190 @@
+/* Copyright (c) 2020 github.com/univrsal <universailp@web.de>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely, subject to the following restrictions:
+ *
+ * 1. The origin of this software must not be misrepresented; you must not
+ *    claim that you wrote the original software. If you use this software
+ *    in a product, an acknowledgment in the product documentation would be
+ *    appreciated but is not required.
+ * 2. Altered source versions must be plainly marked as such, and must not be
+ *    misrepresented as being the original software.
+ * 3. This notice may not be removed or altered from any source distribution.
+ */
+
+/* Shows the counters a process publishes with signal::stats_publisher,
+ * refreshed like top:
+ *
+ *   signal_top [--interval 1000] [--iterations 0] <pid|segment name>
+ *
+ * Rates are per second over the last interval, the latency percentiles
+ * are upper bounds of the sampled send durations of the last interval */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <shm_stats.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+struct row {
+    string id;
+    uint64_t receivers;
+    double sends, misses, dropped, suppressed, muted, hit_rate;
+    uint64_t total, p50, p99;
+};
+
+/* Upper bound of the latency bucket which holds the given fraction of the
+ * samples, zero if there are none. The last bucket has no bound */
+static uint64_t percentile(const uint64_t *latency, double p)
+{
+    uint64_t count = 0, seen = 0;
+    for (size_t i = 0; i < signal::signal_stats::latency_buckets; i++)
+        count += latency[i];
+    if (!count) return 0;
+    for (size_t i = 0; i < signal::signal_stats::latency_buckets; i++) {
+        seen += latency[i];
+        if (double(seen) >= p * double(count)) return uint64_t(1) << (i + 8);
+    }
+    return 0;
+}
+
+static string format_ns(uint64_t ns)
+{
+    char buf[32];
+    if (!ns)
+        return "-";
+    else if (ns >= uint64_t(1) << (signal::signal_stats::latency_buckets + 7))
+        snprintf(buf, sizeof(buf), ">%.1fms", double(ns >> 1) / 1e6);
+    else if (ns < 1000)
+        snprintf(buf, sizeof(buf), "<%uns", unsigned(ns));
+    else if (ns < 1000000)
+        snprintf(buf, sizeof(buf), "<%.1fus", double(ns) / 1e3);
+    else
+        snprintf(buf, sizeof(buf), "<%.1fms", double(ns) / 1e6);
+    return buf;
+}
+
+static map<string, signal::signal_stats>
+snapshot(const signal::stats_reader &r)
+{
+    map<string, signal::signal_stats> s;
+    signal::stats_record record;
+    for (size_t i = 0; i < r.size(); i++) {
+        if (r.read(i, record)) s[record.id] = record.stats;
+    }
+    return s;
+}
+
+static void print(const signal::stats_reader &reader, vector<row> &rows,
+                  bool clear)
+{
+    sort(rows.begin(), rows.end(), [](const row &a, const row &b) {
+        return a.sends != b.sends ? a.sends > b.sends : a.id < b.id;
+    });
+    if (clear) printf("\033[H\033[2J");
+    printf("pid %llu, %zu signals, %llu publishes\n\n",
+           (unsigned long long)reader.pid(), rows.size(),
+           (unsigned long long)reader.published());
+    printf("%-32s %5s %10s %9s %9s %9s %9s %6s %10s %10s %12s\n",
+           "SIGNAL", "RECV", "SENDS/S", "MISS/S", "DROP/S", "SUPP/S",
+           "MUTE/S", "HIT%", "P50", "P99", "TOTAL");
+    for (const auto &r : rows) {
+        char hits[16] = "-";
+        if (r.hit_rate >= 0)
+            snprintf(hits, sizeof(hits), "%.0f", r.hit_rate * 100);
+        printf("%-32.32s %5llu %10.1f %9.1f %9.1f %9.1f %9.1f %6s %10s %10s "
+               "%12llu\n",
+               r.id.c_str(), (unsigned long long)r.receivers, r.sends,
+               r.misses, r.dropped, r.suppressed, r.muted, hits,
+               format_ns(r.p50).c_str(), format_ns(r.p99).c_str(),
+               (unsigned long long)r.total);
+    }
+    fflush(stdout);
+}
+
+static int usage()
+{
+    fprintf(stderr, "Usage: signal_top [--interval ms] [--iterations n] "
+                    "<pid|segment name>\n");
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    long interval = 1000, iterations = 0;
+    string name;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--interval") && i + 1 < argc)
+            interval = atol(argv[++i]);
+        else if (!strcmp(argv[i], "--iterations") && i + 1 < argc)
+            iterations = atol(argv[++i]);
+        else if (argv[i][0] != '-' && name.empty())
+            name = argv[i];
+        else
+            return usage();
+    }
+    if (name.empty() || interval <= 0) return usage();
+    if (name[0] != '/') name = "/libsignal." + name;
+
+    signal::stats_reader reader(name);
+    if (!reader.ok()) {
+        fprintf(stderr, "Can't attach to %s\n", name.c_str());
+        return 1;
+    }
+
+    const bool clear = isatty(STDOUT_FILENO);
+    auto previous = snapshot(reader);
+    for (long n = 0; !iterations || n < iterations; n++) {
+        this_thread::sleep_for(chrono::milliseconds(interval));
+        if (access(("/proc/" + to_string(reader.pid())).c_str(), F_OK)) {
+            fprintf(stderr, "Process %llu exited\n",
+                    (unsigned long long)reader.pid());
+            return 0;
+        }
+
+        auto current = snapshot(reader);
+        const double seconds = double(interval) / 1000;
+        vector<row> rows;
+        for (const auto &entry : current) {
+            signal::signal_stats before;
+            auto old = previous.find(entry.first);
+            if (old != previous.end()) before = old->second;
+
+            const auto &s = entry.second;
+            uint64_t latency[signal::signal_stats::latency_buckets];
+            for (size_t i = 0; i < signal::signal_stats::latency_buckets;
+                 i++)
+                latency[i] = s.latency[i] - before.latency[i];
+
+            /* The hit rate of memoized signals, negative without lookups */
+            const uint64_t hits = s.cache_hits - before.cache_hits;
+            const uint64_t lookups =
+                hits + s.cache_misses - before.cache_misses;
+            rows.push_back({entry.first, s.receivers,
+                            double(s.sends - before.sends) / seconds,
+                            double(s.misses - before.misses) / seconds,
+                            double(s.dropped - before.dropped) / seconds,
+                            double(s.suppressed - before.suppressed) /
+                                seconds,
+                            double(s.muted - before.muted) / seconds,
+                            lookups ? double(hits) / lookups : -1.0,
+                            s.sends, percentile(latency, 0.5),
+                            percentile(latency, 0.99)});
+        }
+        print(reader, rows, clear);
+        previous = std::move(current);
+    }
+    return 0;
+}